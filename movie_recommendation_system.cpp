@@ -8,23 +8,46 @@
 #include <climits>
 #include <cstdlib>
 #include <cmath>
+#include <cctype>
+#include <cstdio>
+#include <sstream>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <cerrno>
 
 using namespace std;
 
+// Hint the CPU to start loading an address into cache before it is needed
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address)
+#endif
+
 // Movie class to store movie information
 class Movie {
 public:
     int id;
     string title;
-    string genre;
-    string actor;
+    string genre;  // primary genre, always genres[0]
+    string actor;  // lead actor, always cast[0]
     double rating;
     string industry; // "Hollywood" or "Bollywood"
+    vector<string> genres;
+    vector<string> cast; // in billing order
     
     Movie() : id(0), title(""), genre(""), actor(""), rating(0.0), industry("") {}
     
     Movie(int id, string title, string genre, string actor, double rating, string industry) 
-        : id(id), title(title), genre(genre), actor(actor), rating(rating), industry(industry) {}
+        : id(id), title(title), genre(genre), actor(actor), rating(rating), industry(industry),
+          genres(1, genre), cast(1, actor) {}
+    
+    Movie(int id, string title, vector<string> genres, vector<string> cast, double rating, string industry) 
+        : id(id), title(title), genre(genres.empty() ? "" : genres[0]), actor(cast.empty() ? "" : cast[0]), 
+          rating(rating), industry(industry), genres(genres), cast(cast) {}
     
     void display() const {
         cout << title << " (" << genre << ", " << actor << ", Rating: " << rating << ", " << industry << ")";
@@ -36,6 +59,11 @@ bool compareByRating(const pair<double, int>& a, const pair<double, int>& b) {
     return a.first > b.first;
 }
 
+// Scores that differ only in their last bits (e.g. sums taken in another order) rank as ties
+double quantizeScore(double score) {
+    return floor(score * 1e9 + 0.5);
+}
+
 // Comparison for sorting by similarity
 bool compareBySimilarity(const pair<int, double>& a, const pair<int, double>& b) {
     return a.second > b.second;
@@ -46,6 +74,390 @@ bool compareActorByRating(const pair<double, string>& a, const pair<double, stri
     return a.first > b.first;
 }
 
+// Count movies and sum ratings by lead actor; returns the number of movies counted
+int countActors(const vector<Movie>& movies, map<string, int>& actorCount, map<string, double>& actorRatingSum) {
+    for (int i = 0; i < movies.size(); i++) {
+        actorCount[movies[i].actor]++;
+        actorRatingSum[movies[i].actor] += movies[i].rating;
+    }
+    return movies.size();
+}
+
+// ============ MINHASH SKETCHES ============
+// Multi-valued genre and cast sets are compared through fixed-size MinHash
+// signatures, so scoring a pair costs the same no matter how large the sets are.
+
+const int MINHASH_SIZE = 32;
+const int LSH_BANDS = 8;
+const int LSH_ROWS = MINHASH_SIZE / LSH_BANDS;
+
+// FNV-1a hash of a string
+unsigned long long hashString(const string& text) {
+    unsigned long long hash = 1469598103934665603ULL;
+    for (int i = 0; i < text.size(); i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// 64-bit finalizer from MurmurHash3, used to derive independent hash functions
+unsigned long long mixHash(unsigned long long hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// MinHash signature of a weighted set
+struct MinHashSignature {
+    unsigned int values[MINHASH_SIZE];
+    bool empty; // no items: every slot stays UINT_MAX and must not count as a match
+    
+    // An item of weight w counts as w distinct copies, so the fraction of matching
+    // slots estimates the weighted Jaccard similarity sum(min) / sum(max)
+    static MinHashSignature fromWeightedSet(const vector<string>& items, const vector<int>& weights) {
+        MinHashSignature signature;
+        signature.empty = items.empty();
+        for (int slot = 0; slot < MINHASH_SIZE; slot++) {
+            signature.values[slot] = UINT_MAX;
+        }
+        
+        for (int i = 0; i < items.size(); i++) {
+            unsigned long long itemHash = hashString(items[i]);
+            for (int copy = 0; copy < weights[i]; copy++) {
+                unsigned long long token = mixHash(itemHash + copy);
+                for (int slot = 0; slot < MINHASH_SIZE; slot++) {
+                    unsigned int value = (unsigned int)(mixHash(token + (slot + 1) * 0x9e3779b97f4a7c15ULL) >> 32);
+                    signature.values[slot] = min(signature.values[slot], value);
+                }
+            }
+        }
+        return signature;
+    }
+};
+
+// Estimated weighted Jaccard similarity, 0 if either set is empty;
+// a branch-free loop over fixed-size arrays the compiler can vectorize
+double estimateJaccard(const MinHashSignature& a, const MinHashSignature& b) {
+    if (a.empty || b.empty) {
+        return 0.0;
+    }
+    
+    int matches = 0;
+    for (int slot = 0; slot < MINHASH_SIZE; slot++) {
+        matches += (a.values[slot] == b.values[slot]);
+    }
+    return matches / (double)MINHASH_SIZE;
+}
+
+// Genre and cast signatures of a movie
+struct MovieSketch {
+    MinHashSignature genres;
+    MinHashSignature cast;
+    
+    // The primary genre weighs 2; the lead actor 3 and the second billed actor 2; everyone else 1
+    static MovieSketch fromMovie(const Movie& movie) {
+        vector<int> genreWeights(movie.genres.size(), 1);
+        if (!genreWeights.empty()) genreWeights[0] = 2;
+        
+        vector<int> castWeights(movie.cast.size(), 1);
+        if (castWeights.size() > 0) castWeights[0] = 3;
+        if (castWeights.size() > 1) castWeights[1] = 2;
+        
+        MovieSketch sketch;
+        sketch.genres = MinHashSignature::fromWeightedSet(movie.genres, genreWeights);
+        sketch.cast = MinHashSignature::fromWeightedSet(movie.cast, castWeights);
+        return sketch;
+    }
+};
+
+// Title search index for typeahead: a path-compressed trie over normalized
+// titles stored in flat arrays. Supports exact, prefix and bounded
+// edit-distance lookups. Titles can be added at any time; the trie is
+// rebuilt on the next query.
+class TitleIndex {
+private:
+    // Trie node; its label is labels[labelStart, labelStart + labelLength) and its
+    // children are contiguous in nodes, sorted by the first character of their label
+    struct Node {
+        int labelStart;
+        int labelLength;
+        int firstChild;
+        int childCount;
+        int firstPosting;
+        int postingCount;
+    };
+    
+    vector<Node> nodes;
+    string labels;
+    vector<int> postings; // movie ids of each node, ascending
+    vector<pair<string, int> > pendingTitles; // normalized titles added since the last build
+    
+    // Build the subtree of node from the sorted titles [lo, hi), which share their first depth characters
+    void buildNode(int node, const vector<pair<string, int> >& titles, int lo, int hi, int depth) {
+        int i = lo;
+        nodes[node].firstPosting = postings.size();
+        while (i < hi && (int)titles[i].first.size() == depth) {
+            postings.push_back(titles[i].second);
+            i++;
+        }
+        nodes[node].postingCount = postings.size() - nodes[node].firstPosting;
+        
+        // Group the remaining titles by their next character
+        vector<pair<int, int> > groups;
+        while (i < hi) {
+            int j = i;
+            while (j < hi && titles[j].first[depth] == titles[i].first[depth]) j++;
+            groups.push_back(make_pair(i, j));
+            i = j;
+        }
+        
+        int firstChild = nodes.size();
+        nodes[node].firstChild = firstChild;
+        nodes[node].childCount = groups.size();
+        nodes.resize(nodes.size() + groups.size());
+        
+        for (int g = 0; g < groups.size(); g++) {
+            // The edge label runs to the longest common prefix of the group
+            const string& first = titles[groups[g].first].first;
+            const string& last = titles[groups[g].second - 1].first;
+            int end = depth + 1;
+            while (end < (int)first.size() && end < (int)last.size() && first[end] == last[end]) end++;
+            
+            int child = firstChild + g;
+            nodes[child].labelStart = labels.size();
+            nodes[child].labelLength = end - depth;
+            labels.append(first, depth, end - depth);
+            buildNode(child, titles, groups[g].first, groups[g].second, end);
+        }
+    }
+    
+    // Collect every (title, id) pair of the subtree, used to rebuild after new titles are added
+    void collectTitles(int node, string& prefix, vector<pair<string, int> >& titles) {
+        prefix.append(labels, nodes[node].labelStart, nodes[node].labelLength);
+        for (int i = 0; i < nodes[node].postingCount; i++) {
+            titles.push_back(make_pair(prefix, postings[nodes[node].firstPosting + i]));
+        }
+        for (int i = 0; i < nodes[node].childCount; i++) {
+            collectTitles(nodes[node].firstChild + i, prefix, titles);
+        }
+        prefix.erase(prefix.size() - nodes[node].labelLength);
+    }
+    
+    // Rebuild the trie if titles were added; the root always exists afterwards, even with no titles
+    void ensureBuilt() {
+        if (pendingTitles.empty() && !nodes.empty()) {
+            return;
+        }
+        
+        vector<pair<string, int> > titles;
+        titles.swap(pendingTitles);
+        if (!nodes.empty()) {
+            string prefix;
+            collectTitles(0, prefix, titles);
+        }
+        sort(titles.begin(), titles.end());
+        
+        nodes.clear();
+        labels.clear();
+        postings.clear();
+        nodes.resize(1);
+        nodes[0].labelStart = 0;
+        nodes[0].labelLength = 0;
+        buildNode(0, titles, 0, titles.size(), 0);
+    }
+    
+    // Find the child of node whose label starts with c, -1 if there is none.
+    // Compares bytes as unsigned, like the string sort that ordered the children.
+    int findChild(int node, unsigned char c) {
+        int lo = nodes[node].firstChild;
+        int hi = lo + nodes[node].childCount;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            unsigned char label = labels[nodes[mid].labelStart];
+            if (label == c) return mid;
+            if (label < c) lo = mid + 1;
+            else hi = mid;
+        }
+        return -1;
+    }
+    
+    // Follow key from the root; returns the node whose subtree holds every title
+    // starting with key (it may end inside that node's label), or -1
+    int findPrefixNode(const string& key, bool& endsInsideLabel) {
+        int node = 0;
+        int pos = 0;
+        endsInsideLabel = false;
+        
+        while (pos < (int)key.size()) {
+            node = findChild(node, key[pos]);
+            if (node == -1) return -1;
+            
+            const Node& current = nodes[node];
+            for (int i = 0; i < current.labelLength; i++, pos++) {
+                if (pos == (int)key.size()) {
+                    endsInsideLabel = true;
+                    return node;
+                }
+                if (labels[current.labelStart + i] != key[pos]) return -1;
+            }
+        }
+        return node;
+    }
+    
+    // Depth-first walk keeping the edit distance row of the query against the current title prefix
+    void fuzzySearch(int node, const string& key, const vector<int>& row, int maxEdits, 
+                     vector<pair<int, int> >& matches) {
+        const Node& current = nodes[node];
+        if (current.postingCount > 0 && row.back() <= maxEdits) {
+            for (int i = 0; i < current.postingCount; i++) {
+                matches.push_back(make_pair(row.back(), postings[current.firstPosting + i]));
+            }
+        }
+        
+        for (int c = 0; c < current.childCount; c++) {
+            int child = current.firstChild + c;
+            vector<int> childRow = row;
+            bool reachable = true;
+            
+            for (int i = 0; i < nodes[child].labelLength && reachable; i++) {
+                char label = labels[nodes[child].labelStart + i];
+                vector<int> nextRow(key.size() + 1);
+                nextRow[0] = childRow[0] + 1;
+                int rowMin = nextRow[0];
+                
+                for (int j = 1; j <= key.size(); j++) {
+                    int substitution = childRow[j - 1] + (key[j - 1] != label ? 1 : 0);
+                    nextRow[j] = min(substitution, min(childRow[j] + 1, nextRow[j - 1] + 1));
+                    rowMin = min(rowMin, nextRow[j]);
+                }
+                
+                // No title below can get back within maxEdits
+                reachable = rowMin <= maxEdits;
+                childRow.swap(nextRow);
+            }
+            
+            if (reachable) {
+                fuzzySearch(child, key, childRow, maxEdits, matches);
+            }
+        }
+    }
+    
+public:
+    // Lowercase ASCII letters and digits; bytes of non-ASCII (UTF-8) characters are kept
+    // as they are. Apostrophes are dropped and any other run of characters becomes a single space.
+    static string normalizeTitle(const string& title) {
+        string normalized;
+        bool pendingSpace = false;
+        for (int i = 0; i < title.size(); i++) {
+            unsigned char c = title[i];
+            if (c >= 0x80 || isalnum(c)) {
+                if (pendingSpace && !normalized.empty()) normalized += ' ';
+                normalized += (c >= 0x80) ? (char)c : (char)tolower(c);
+                pendingSpace = false;
+            }
+            else if (c != '\'') {
+                pendingSpace = true;
+            }
+        }
+        return normalized;
+    }
+    
+    // Edits allowed for a query of the given length: none for short queries, up to 2 for long ones
+    static int maxEditsFor(int length) {
+        if (length < 4) return 0;
+        if (length < 8) return 1;
+        return 2;
+    }
+    
+    void addTitle(const string& title, int id) {
+        pendingTitles.push_back(make_pair(normalizeTitle(title), id));
+    }
+    
+    // Lowest id whose normalized title equals the normalized query, -1 if none
+    int findExact(const string& title) {
+        ensureBuilt();
+        string key = normalizeTitle(title);
+        bool endsInsideLabel;
+        int node = key.empty() ? -1 : findPrefixNode(key, endsInsideLabel);
+        
+        if (node == -1 || endsInsideLabel || nodes[node].postingCount == 0) {
+            return -1;
+        }
+        return postings[nodes[node].firstPosting];
+    }
+    
+    // Ids of titles starting with the prefix, in title order
+    vector<int> completePrefix(const string& prefix, int limit = 10) {
+        vector<int> ids;
+        ensureBuilt();
+        string key = normalizeTitle(prefix);
+        bool endsInsideLabel;
+        int start = findPrefixNode(key, endsInsideLabel);
+        if (start == -1) {
+            return ids;
+        }
+        
+        stack<int> pending;
+        pending.push(start);
+        while (!pending.empty() && (int)ids.size() < limit) {
+            int node = pending.top();
+            pending.pop();
+            
+            for (int i = 0; i < nodes[node].postingCount && (int)ids.size() < limit; i++) {
+                ids.push_back(postings[nodes[node].firstPosting + i]);
+            }
+            for (int i = nodes[node].childCount - 1; i >= 0; i--) {
+                pending.push(nodes[node].firstChild + i);
+            }
+        }
+        return ids;
+    }
+    
+    // (edit distance, id) of titles within maxEdits of the query, closest first
+    vector<pair<int, int> > fuzzyMatch(const string& title, int maxEdits, int limit = 10) {
+        vector<pair<int, int> > matches;
+        ensureBuilt();
+        string key = normalizeTitle(title);
+        
+        vector<int> row(key.size() + 1);
+        for (int j = 0; j <= key.size(); j++) {
+            row[j] = j;
+        }
+        fuzzySearch(0, key, row, maxEdits, matches);
+        
+        sort(matches.begin(), matches.end());
+        if ((int)matches.size() > limit) {
+            matches.resize(max(limit, 0));
+        }
+        return matches;
+    }
+    
+    // Exact match if there is one, otherwise the closest title within maxEditsFor(query length)
+    int findClosest(const string& title, int& editDistance) {
+        int id = findExact(title);
+        if (id != -1) {
+            editDistance = 0;
+            return id;
+        }
+        
+        int maxEdits = maxEditsFor(normalizeTitle(title).size());
+        if (maxEdits == 0) {
+            return -1;
+        }
+        
+        vector<pair<int, int> > matches = fuzzyMatch(title, maxEdits, 1);
+        if (matches.empty()) {
+            return -1;
+        }
+        editDistance = matches[0].first;
+        return matches[0].second;
+    }
+};
+
 // Content-Based Recommendation System
 class ContentBasedRecommender {
 private:
@@ -53,30 +465,43 @@ private:
     map<string, vector<int> > genreToMovies;
     map<string, vector<int> > actorToMovies;
     map<string, vector<int> > industryToMovies;
+    TitleIndex titleIndex;
     
 public:
     void addMovie(const Movie& movie) {
         int index = movies.size();
         movies.push_back(movie);
         
-        // Index by genre
-        genreToMovies[movie.genre].push_back(index);
+        // Index by title
+        titleIndex.addTitle(movie.title, index);
         
-        // Index by actor
-        actorToMovies[movie.actor].push_back(index);
+        // Index by every genre and every cast member, once even if listed twice
+        for (int i = 0; i < movie.genres.size(); i++) {
+            vector<int>& genreMovies = genreToMovies[movie.genres[i]];
+            if (genreMovies.empty() || genreMovies.back() != index) genreMovies.push_back(index);
+        }
+        for (int i = 0; i < movie.cast.size(); i++) {
+            vector<int>& actorMovies = actorToMovies[movie.cast[i]];
+            if (actorMovies.empty() || actorMovies.back() != index) actorMovies.push_back(index);
+        }
         
         // Index by industry
         industryToMovies[movie.industry].push_back(index);
     }
     
-    // Helper function to find movie index by title
+    // Helper function to find movie index by title (ignoring case and punctuation)
     int findMovieIndex(const string& movieTitle) {
-        for (int i = 0; i < movies.size(); i++) {
-            if (movies[i].title == movieTitle) {
-                return i;
-            }
+        return titleIndex.findExact(movieTitle);
+    }
+    
+    // Titles starting with the given prefix, for typeahead
+    vector<string> completeTitle(const string& prefix, int limit = 10) {
+        vector<string> titles;
+        vector<int> indices = titleIndex.completePrefix(prefix, limit);
+        for (int i = 0; i < indices.size(); i++) {
+            titles.push_back(movies[indices[i]].title);
         }
-        return -1;
+        return titles;
     }
     
     // Get all unique genres for a specific industry
@@ -92,10 +517,13 @@ public:
         map<string, bool> genreExists;
         
         for (int i = 0; i < industryMovieIndices.size(); i++) {
-            string genre = movies[industryMovieIndices[i]].genre;
-            if (!genreExists[genre]) {
-                genreExists[genre] = true;
-                genres.push_back(genre);
+            const vector<string>& movieGenres = movies[industryMovieIndices[i]].genres;
+            for (int j = 0; j < movieGenres.size(); j++) {
+                string genre = movieGenres[j];
+                if (!genreExists[genre]) {
+                    genreExists[genre] = true;
+                    genres.push_back(genre);
+                }
             }
         }
         
@@ -138,231 +566,1890 @@ public:
                 genreMovies.push_back(make_pair(movies[idx], idx));
             }
         }
-        
-        return genreMovies;
+        
+        return genreMovies;
+    }
+    
+    // Recommend movies by genre and industry (top rated)
+    vector<Movie> recommendByGenreAndIndustry(const string& genre, const string& industry, int topN = 5) {
+        vector<Movie> recommendations;
+        
+        if (genreToMovies.find(genre) == genreToMovies.end()) {
+            return recommendations;
+        }
+        
+        vector<int> genreMovies = genreToMovies[genre];
+        
+        // Create a vector of rating-index pairs for sorting
+        vector<pair<double, int> > ratingPairs;
+        
+        for (int i = 0; i < genreMovies.size(); i++) {
+            int idx = genreMovies[i];
+            if (movies[idx].industry == industry) {
+                ratingPairs.push_back(make_pair(movies[idx].rating, idx));
+            }
+        }
+        
+        // Sort by rating (highest first)
+        sort(ratingPairs.begin(), ratingPairs.end(), compareByRating);
+        
+        // Take top N
+        for (int i = 0; i < min(topN, (int)ratingPairs.size()); i++) {
+            recommendations.push_back(movies[ratingPairs[i].second]);
+        }
+        
+        return recommendations;
+    }
+    
+    // Recommend movies by actor
+    vector<Movie> recommendByActor(const string& actor, int topN = 5) {
+        vector<Movie> recommendations;
+        
+        if (actorToMovies.find(actor) == actorToMovies.end()) {
+            return recommendations;
+        }
+        
+        vector<int> actorMovies = actorToMovies[actor];
+        
+        // Create a vector of rating-index pairs for sorting
+        vector<pair<double, int> > ratingPairs;
+        
+        for (int i = 0; i < actorMovies.size(); i++) {
+            int idx = actorMovies[i];
+            ratingPairs.push_back(make_pair(movies[idx].rating, idx));
+        }
+        
+        // Sort by rating (highest first)
+        sort(ratingPairs.begin(), ratingPairs.end(), compareByRating);
+        
+        // Take top N
+        for (int i = 0; i < min(topN, (int)ratingPairs.size()); i++) {
+            recommendations.push_back(movies[ratingPairs[i].second]);
+        }
+        
+        return recommendations;
+    }
+    
+    int getMovieCount() {
+        return movies.size();
+    }
+    
+    string getMovieTitle(int index) {
+        if (index >= 0 && index < movies.size()) {
+            return movies[index].title;
+        }
+        return "";
+    }
+    
+    Movie getMovieByIndex(int index) {
+        if (index >= 0 && index < movies.size()) {
+            return movies[index];
+        }
+        return Movie();
+    }
+    
+    // Get movie by title, falling back to the closest title for typos
+    Movie getMovieByTitle(const string& title) {
+        int editDistance;
+        int idx = titleIndex.findClosest(title, editDistance);
+        if (idx != -1) {
+            return movies[idx];
+        }
+        return Movie();
+    }
+};
+
+// Similarity policies fix the feature weights and the edge threshold at
+// compile time, so each GraphBasedRecommender build is specialized per policy
+
+// Balanced weights (the original 30/30/20/20 split)
+struct DefaultSimilarityPolicy {
+    static double genreWeight() { return 0.3; }
+    static double actorWeight() { return 0.3; }
+    static double industryWeight() { return 0.2; }
+    static double ratingWeight() { return 0.2; }
+    static double edgeThreshold() { return 0.2; }
+};
+
+// Favors movies of the same genre
+struct GenreFocusedSimilarityPolicy {
+    static double genreWeight() { return 0.5; }
+    static double actorWeight() { return 0.2; }
+    static double industryWeight() { return 0.1; }
+    static double ratingWeight() { return 0.2; }
+    static double edgeThreshold() { return 0.3; }
+};
+
+// Favors movies with the same actor
+struct ActorFocusedSimilarityPolicy {
+    static double genreWeight() { return 0.2; }
+    static double actorWeight() { return 0.5; }
+    static double industryWeight() { return 0.1; }
+    static double ratingWeight() { return 0.2; }
+    static double edgeThreshold() { return 0.3; }
+};
+
+// Ignores the industry so Hollywood and Bollywood movies mix freely
+struct CrossIndustrySimilarityPolicy {
+    static double genreWeight() { return 0.4; }
+    static double actorWeight() { return 0.4; }
+    static double industryWeight() { return 0.0; }
+    static double ratingWeight() { return 0.2; }
+    static double edgeThreshold() { return 0.3; }
+};
+
+// Wall clock time in seconds, used for build progress reporting
+double currentTimeSeconds() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
+// A directed similarity graph edge as it is spilled to disk during an out-of-core build
+struct SimilarityEdge {
+    int from;
+    int to;
+    double similarity;
+};
+
+// Edge order inside a run: by source movie, then highest similarity first
+bool compareEdges(const SimilarityEdge& a, const SimilarityEdge& b) {
+    if (a.from != b.from) return a.from < b.from;
+    if (a.similarity != b.similarity) return a.similarity > b.similarity;
+    return a.to < b.to;
+}
+
+// Heap order for the k-way merge (smallest edge on top)
+struct EdgeMergeOrder {
+    bool operator()(const pair<SimilarityEdge, int>& a, const pair<SimilarityEdge, int>& b) const {
+        return compareEdges(b.first, a.first);
+    }
+};
+
+// Options for building the similarity graph out of core. The memory limit bounds
+// the working set of the build only: the edge buffer and the adjacency rows. The
+// movies, their sketches and the title index are not counted, nor are the merge
+// heap and the stdio read buffers (a few KB per open run, at most 64 runs).
+struct ExternalBuildOptions {
+    size_t memoryLimit;    // bytes for the edge buffer and the final graph
+    string tempDirectory;  // where sorted edge runs are spilled
+    int blockSize;         // movies processed per block
+    int maxNeighbors;      // neighbors kept per movie, 0 keeps all of them
+    bool reportProgress;
+    
+    ExternalBuildOptions() : memoryLimit(256 * 1024 * 1024), tempDirectory("/tmp"), blockSize(1024), 
+                             maxNeighbors(0), reportProgress(false) {}
+};
+
+// Reads sorted edge runs back and returns their edges in merged order
+class EdgeRunMerger {
+private:
+    vector<FILE*> files;
+    priority_queue<pair<SimilarityEdge, int>, vector<pair<SimilarityEdge, int> >, EdgeMergeOrder> heap;
+    
+    void readNextEdge(int run) {
+        SimilarityEdge edge;
+        if (fread(&edge, sizeof(SimilarityEdge), 1, files[run]) == 1) {
+            heap.push(make_pair(edge, run));
+        }
+    }
+    
+public:
+    ~EdgeRunMerger() {
+        for (int i = 0; i < files.size(); i++) {
+            fclose(files[i]);
+        }
+    }
+    
+    bool open(const vector<string>& paths) {
+        for (int i = 0; i < paths.size(); i++) {
+            FILE* file = fopen(paths[i].c_str(), "rb");
+            if (file == NULL) {
+                return false;
+            }
+            files.push_back(file);
+            readNextEdge(files.size() - 1);
+        }
+        return true;
+    }
+    
+    bool next(SimilarityEdge& edge) {
+        if (heap.empty()) {
+            return false;
+        }
+        edge = heap.top().first;
+        int run = heap.top().second;
+        heap.pop();
+        readNextEdge(run);
+        return true;
+    }
+};
+
+// Owns the temp files holding sorted edge runs and removes them when done
+class EdgeRunStore {
+private:
+    string directory;
+    vector<string> runPaths;
+    
+    static const int MAX_MERGE_FAN_IN = 64;
+    
+    FILE* createRunFile(string& path) {
+        string pattern = directory + "/movie_graph_run_XXXXXX";
+        vector<char> name(pattern.begin(), pattern.end());
+        name.push_back('\0');
+        
+        int fd = mkstemp(&name[0]);
+        if (fd == -1) {
+            return NULL;
+        }
+        path = &name[0];
+        return fdopen(fd, "wb");
+    }
+    
+    // Merge the first runs into a single one so the final merge stays within MAX_MERGE_FAN_IN files
+    bool mergeOldestRuns(int count) {
+        vector<string> inputs(runPaths.begin(), runPaths.begin() + count);
+        string path;
+        FILE* output = createRunFile(path);
+        if (output == NULL) {
+            return false;
+        }
+        
+        bool ok = true;
+        {
+            EdgeRunMerger merger;
+            ok = merger.open(inputs);
+            SimilarityEdge edge;
+            while (ok && merger.next(edge)) {
+                ok = fwrite(&edge, sizeof(SimilarityEdge), 1, output) == 1;
+            }
+        }
+        ok = (fclose(output) == 0) && ok;
+        
+        for (int i = 0; i < inputs.size(); i++) {
+            remove(inputs[i].c_str());
+        }
+        runPaths.erase(runPaths.begin(), runPaths.begin() + count);
+        runPaths.push_back(path);
+        return ok;
+    }
+    
+public:
+    EdgeRunStore(const string& directory) : directory(directory) {}
+    
+    ~EdgeRunStore() {
+        for (int i = 0; i < runPaths.size(); i++) {
+            remove(runPaths[i].c_str());
+        }
+    }
+    
+    // Sort the edges and spill them to a new run file
+    bool writeRun(vector<SimilarityEdge>& edges) {
+        sort(edges.begin(), edges.end(), compareEdges);
+        
+        string path;
+        FILE* output = createRunFile(path);
+        if (output == NULL) {
+            return false;
+        }
+        runPaths.push_back(path);
+        
+        bool ok = fwrite(&edges[0], sizeof(SimilarityEdge), edges.size(), output) == edges.size();
+        return (fclose(output) == 0) && ok;
+    }
+    
+    int getRunCount() {
+        return runPaths.size();
+    }
+    
+    // Open a merger over all runs, pre-merging them when there are too many to open at once
+    bool openMerger(EdgeRunMerger& merger) {
+        while (runPaths.size() > MAX_MERGE_FAN_IN) {
+            if (!mergeOldestRuns(MAX_MERGE_FAN_IN)) {
+                return false;
+            }
+        }
+        return merger.open(runPaths);
+    }
+};
+
+// Interned genres and industry of a movie, so graph scans compare ints instead of strings.
+// Its genre codes are genreCodeList[firstGenre, firstGenre + genreCount) of the recommender.
+struct MovieAttributeCodes {
+    int firstGenre;
+    int genreCount;
+    int industry;
+};
+
+// Interned genre and industry wanted by a graph query
+struct GenreQueryCodes {
+    int genre;
+    int industry;
+};
+
+// One query of a batched graph recommendation
+struct GenreGraphQuery {
+    string genre;
+    string industry;
+    int topN;
+    
+    GenreGraphQuery(const string& genre, const string& industry, int topN = 5) 
+        : genre(genre), industry(industry), topN(topN) {}
+};
+
+// Orders for renumbering movies after loading, to improve memory locality
+enum MovieOrdering {
+    ORDER_BY_ATTRIBUTES, // by industry, genre and rating: each genre becomes a contiguous range
+    ORDER_BY_RCM         // reverse Cuthill-McKee: neighbors get nearby indices
+};
+
+// Graph-Based Recommendation System
+class GraphBasedRecommender {
+private:
+    vector<Movie> movies;
+    vector<vector<pair<int, double> > > adjList; // adjacency list with similarity scores
+    map<string, int> titleToId;
+    map<string, vector<int> > genreToMovies;
+    TitleIndex titleIndex;
+    vector<MovieAttributeCodes> attributeCodes;
+    vector<int> genreCodeList; // genre codes of every movie, in insertion order
+    vector<MovieSketch> sketches; // genre and cast MinHash signatures of each movie
+    map<string, int> genreCodes;
+    map<string, int> industryCodes;
+    map<int, int> idToIndex; // external movie id to internal index, stable across reordering
+    
+    // Batched queries keep this many adjacency row scans in flight at once
+    static const int INTERLEAVE_WIDTH = 16;
+    // How many neighbors ahead a row scan prefetches their attribute codes
+    static const int NEIGHBOR_PREFETCH_DISTANCE = 8;
+    
+    // Highest score first; ties go to the lower external movie id, so rankings
+    // do not depend on the internal numbering chosen by reorderMovies
+    struct ScoreOrder {
+        const vector<Movie>& movies;
+        
+        ScoreOrder(const vector<Movie>& movies) : movies(movies) {}
+        
+        bool operator()(const pair<double, int>& a, const pair<double, int>& b) const {
+            double scoreA = quantizeScore(a.first);
+            double scoreB = quantizeScore(b.first);
+            if (scoreA != scoreB) {
+                return scoreA > scoreB;
+            }
+            return movies[a.second].id < movies[b.second].id;
+        }
+    };
+    
+    // Progress of one adjacency row scan in the interleaved executor
+    struct RowScan {
+        int work;  // index into the rows being scanned, -1 when the slot is idle
+        int stage; // 0: row header requested, 1: neighbors requested, 2: ready to scan
+    };
+    
+    // Averages the similarity to neighbors that have the genre and industry of the row's query
+    struct GenreGraphScorer {
+        const vector<MovieAttributeCodes>& attributeCodes;
+        const vector<int>& genreCodeList;
+        const vector<int>& workQuery;
+        const vector<GenreQueryCodes>& queryCodes;
+        vector<double> averageSimilarity;
+        
+        GenreGraphScorer(const vector<MovieAttributeCodes>& attributeCodes, const vector<int>& genreCodeList, 
+                         const vector<int>& workQuery, const vector<GenreQueryCodes>& queryCodes) 
+            : attributeCodes(attributeCodes), genreCodeList(genreCodeList), workQuery(workQuery), 
+              queryCodes(queryCodes), averageSimilarity(workQuery.size()) {}
+        
+        bool hasGenre(const MovieAttributeCodes& codes, int genre) const {
+            for (int g = 0; g < codes.genreCount; g++) {
+                if (genreCodeList[codes.firstGenre + g] == genre) return true;
+            }
+            return false;
+        }
+        
+        void visitRow(int work, const vector<pair<int, double> >& row) {
+            const GenreQueryCodes& wanted = queryCodes[workQuery[work]];
+            double totalSimilarity = 0.0;
+            int similarCount = 0;
+            
+            for (int j = 0; j < row.size(); j++) {
+                if (j + NEIGHBOR_PREFETCH_DISTANCE < (int)row.size()) {
+                    PREFETCH(&attributeCodes[row[j + NEIGHBOR_PREFETCH_DISTANCE].first]);
+                }
+                const MovieAttributeCodes& codes = attributeCodes[row[j].first];
+                if (codes.industry == wanted.industry && hasGenre(codes, wanted.genre)) {
+                    totalSimilarity += row[j].second;
+                    similarCount++;
+                }
+            }
+            
+            averageSimilarity[work] = (similarCount > 0) ? totalSimilarity / similarCount : 0.0;
+        }
+    };
+    
+    // Collects every scanned row as (similarity, neighbor) pairs
+    struct SimilarRowCollector {
+        vector<vector<pair<double, int> > > rows;
+        
+        SimilarRowCollector(int rowCount) : rows(rowCount) {}
+        
+        void visitRow(int work, const vector<pair<int, double> >& row) {
+            rows[work].reserve(row.size());
+            for (int j = 0; j < row.size(); j++) {
+                rows[work].push_back(make_pair(row[j].second, row[j].first));
+            }
+        }
+    };
+    
+    // Scan the adjacency rows of the given movies, interleaving up to INTERLEAVE_WIDTH scans.
+    // Each scan issues a prefetch for its next step and yields to the others, so the
+    // cache misses on the row header, the row and the neighbors overlap instead of stalling.
+    template <class RowVisitor>
+    void scanRowsInterleaved(const vector<int>& rows, RowVisitor& visitor) {
+        vector<RowScan> slots(min((int)INTERLEAVE_WIDTH, (int)rows.size()));
+        int nextWork = 0;
+        int active = slots.size();
+        
+        for (int s = 0; s < slots.size(); s++) {
+            slots[s].work = nextWork++;
+            slots[s].stage = 0;
+            PREFETCH(&adjList[rows[slots[s].work]]);
+        }
+        
+        while (active > 0) {
+            for (int s = 0; s < slots.size(); s++) {
+                RowScan& scan = slots[s];
+                if (scan.work == -1) continue;
+                const vector<pair<int, double> >& row = adjList[rows[scan.work]];
+                
+                if (scan.stage == 0) {
+                    if (!row.empty()) PREFETCH(&row[0]);
+                    scan.stage = 1;
+                }
+                else if (scan.stage == 1) {
+                    for (int j = 0; j < row.size() && j < NEIGHBOR_PREFETCH_DISTANCE; j++) {
+                        PREFETCH(&attributeCodes[row[j].first]);
+                    }
+                    scan.stage = 2;
+                }
+                else {
+                    visitor.visitRow(scan.work, row);
+                    
+                    if (nextWork < (int)rows.size()) {
+                        scan.work = nextWork++;
+                        scan.stage = 0;
+                        PREFETCH(&adjList[rows[scan.work]]);
+                    }
+                    else {
+                        scan.work = -1;
+                        active--;
+                    }
+                }
+            }
+        }
+    }
+    
+    // Sorts movie indices by industry, genre, rating (highest first) and insertion order
+    struct AttributeOrder {
+        const vector<Movie>& movies;
+        
+        AttributeOrder(const vector<Movie>& movies) : movies(movies) {}
+        
+        bool operator()(int a, int b) const {
+            if (movies[a].industry != movies[b].industry) return movies[a].industry < movies[b].industry;
+            if (movies[a].genre != movies[b].genre) return movies[a].genre < movies[b].genre;
+            if (movies[a].rating != movies[b].rating) return movies[a].rating > movies[b].rating;
+            return a < b;
+        }
+    };
+    
+    // Sorts movie indices by rating (highest first) and insertion order
+    struct RatingOrder {
+        const vector<Movie>& movies;
+        
+        RatingOrder(const vector<Movie>& movies) : movies(movies) {}
+        
+        bool operator()(int a, int b) const {
+            if (movies[a].rating != movies[b].rating) return movies[a].rating > movies[b].rating;
+            return a < b;
+        }
+    };
+    
+    // Sorts movie indices by degree in the similarity graph (lowest first)
+    struct DegreeOrder {
+        const vector<vector<pair<int, double> > >& adjList;
+        
+        DegreeOrder(const vector<vector<pair<int, double> > >& adjList) : adjList(adjList) {}
+        
+        bool operator()(int a, int b) const {
+            if (adjList[a].size() != adjList[b].size()) return adjList[a].size() < adjList[b].size();
+            return a < b;
+        }
+    };
+    
+    vector<int> computeAttributeOrder() {
+        vector<int> order(movies.size());
+        for (int i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        sort(order.begin(), order.end(), AttributeOrder(movies));
+        return order;
+    }
+    
+    // Reverse Cuthill-McKee: breadth-first from a lowest-degree movie of each component,
+    // visiting neighbors by increasing degree, then reversed. This reduces the bandwidth
+    // of the adjacency matrix, so neighbors end up close to each other in memory.
+    vector<int> computeRcmOrder() {
+        int n = movies.size();
+        vector<int> byDegree(n);
+        for (int i = 0; i < n; i++) {
+            byDegree[i] = i;
+        }
+        
+        if ((int)adjList.size() != n) {
+            return byDegree; // no graph yet
+        }
+        sort(byDegree.begin(), byDegree.end(), DegreeOrder(adjList));
+        
+        // order doubles as the breadth-first queue
+        vector<int> order;
+        order.reserve(n);
+        vector<bool> visited(n, false);
+        
+        for (int s = 0; s < n; s++) {
+            int start = byDegree[s];
+            if (visited[start]) continue;
+            
+            visited[start] = true;
+            order.push_back(start);
+            
+            for (int head = order.size() - 1; head < order.size(); head++) {
+                int movieId = order[head];
+                vector<int> unvisited;
+                for (int j = 0; j < adjList[movieId].size(); j++) {
+                    int neighborId = adjList[movieId][j].first;
+                    if (!visited[neighborId]) {
+                        visited[neighborId] = true;
+                        unvisited.push_back(neighborId);
+                    }
+                }
+                sort(unvisited.begin(), unvisited.end(), DegreeOrder(adjList));
+                order.insert(order.end(), unvisited.begin(), unvisited.end());
+            }
+        }
+        
+        reverse(order.begin(), order.end());
+        return order;
+    }
+    
+    // Renumber movies so that order[i] becomes index i, remapping every index consistently
+    void applyOrdering(const vector<int>& order) {
+        int n = movies.size();
+        vector<int> newIndex(n);
+        for (int i = 0; i < n; i++) {
+            newIndex[order[i]] = i;
+        }
+        
+        vector<Movie> reorderedMovies(n);
+        vector<MovieAttributeCodes> reorderedCodes(n);
+        vector<MovieSketch> reorderedSketches(n);
+        for (int i = 0; i < n; i++) {
+            reorderedMovies[i] = movies[order[i]];
+            reorderedCodes[i] = attributeCodes[order[i]];
+            reorderedSketches[i] = sketches[order[i]];
+        }
+        movies.swap(reorderedMovies);
+        attributeCodes.swap(reorderedCodes);
+        sketches.swap(reorderedSketches);
+        
+        // Rows follow their movie; neighbors are sorted by their new index so scans walk memory forward
+        if ((int)adjList.size() == n) {
+            vector<vector<pair<int, double> > > reorderedAdjList(n);
+            for (int i = 0; i < n; i++) {
+                reorderedAdjList[i].swap(adjList[order[i]]);
+                vector<pair<int, double> >& row = reorderedAdjList[i];
+                for (int j = 0; j < row.size(); j++) {
+                    row[j].first = newIndex[row[j].first];
+                }
+                sort(row.begin(), row.end());
+            }
+            adjList.swap(reorderedAdjList);
+        }
+        
+        map<string, int>::iterator titleIt;
+        for (titleIt = titleToId.begin(); titleIt != titleToId.end(); ++titleIt) {
+            titleIt->second = newIndex[titleIt->second];
+        }
+        
+        map<string, vector<int> >::iterator genreIt;
+        for (genreIt = genreToMovies.begin(); genreIt != genreToMovies.end(); ++genreIt) {
+            vector<int>& genreMovies = genreIt->second;
+            for (int i = 0; i < genreMovies.size(); i++) {
+                genreMovies[i] = newIndex[genreMovies[i]];
+            }
+            sort(genreMovies.begin(), genreMovies.end());
+        }
+        
+        map<int, int>::iterator idIt;
+        for (idIt = idToIndex.begin(); idIt != idToIndex.end(); ++idIt) {
+            idIt->second = newIndex[idIt->second];
+        }
+        
+        titleIndex = TitleIndex();
+        for (int i = 0; i < n; i++) {
+            titleIndex.addTitle(movies[i].title, i);
+        }
+    }
+    
+    static int internCode(map<string, int>& codes, const string& name) {
+        map<string, int>::iterator it = codes.find(name);
+        if (it != codes.end()) {
+            return it->second;
+        }
+        int code = codes.size();
+        codes[name] = code;
+        return code;
+    }
+    
+    // Calculate similarity between two movies using the weights of the given policy
+    template <class SimilarityPolicy>
+    double calculateSimilarity(const Movie& m1, const MovieSketch& s1, const Movie& m2, const MovieSketch& s2) {
+        double similarity = 0.0;
+        
+        // Genre similarity (estimated weighted Jaccard of the genre sets)
+        similarity += SimilarityPolicy::genreWeight() * estimateJaccard(s1.genres, s2.genres);
+        
+        // Actor similarity (estimated weighted Jaccard of the cast sets)
+        similarity += SimilarityPolicy::actorWeight() * estimateJaccard(s1.cast, s2.cast);
+        
+        // Industry similarity
+        if (m1.industry == m2.industry) similarity += SimilarityPolicy::industryWeight();
+        
+        // Rating similarity - closer ratings mean higher similarity
+        double ratingDiff = fabs(m1.rating - m2.rating) / 10.0;
+        similarity += SimilarityPolicy::ratingWeight() * (1.0 - ratingDiff);
+        
+        return similarity;
+    }
+    
+public:
+    void addMovie(const Movie& movie) {
+        int id = movies.size();
+        movies.push_back(movie);
+        titleToId[movie.title] = id;
+        titleIndex.addTitle(movie.title, id);
+        
+        idToIndex[movie.id] = id;
+        
+        // Index by every genre, like ContentBasedRecommender, so every genre it offers has graph results
+        MovieAttributeCodes codes;
+        codes.firstGenre = genreCodeList.size();
+        for (int i = 0; i < movie.genres.size(); i++) {
+            vector<int>& genreMovies = genreToMovies[movie.genres[i]];
+            if (!genreMovies.empty() && genreMovies.back() == id) continue; // listed twice
+            genreMovies.push_back(id);
+            genreCodeList.push_back(internCode(genreCodes, movie.genres[i]));
+        }
+        codes.genreCount = genreCodeList.size() - codes.firstGenre;
+        codes.industry = internCode(industryCodes, movie.industry);
+        attributeCodes.push_back(codes);
+        
+        sketches.push_back(MovieSketch::fromMovie(movie));
+    }
+    
+    // Build similarity graph between all movies using the default weights
+    void buildSimilarityGraph() {
+        buildSimilarityGraphWith<DefaultSimilarityPolicy>();
+    }
+    
+    // Build similarity graph between all movies using the given policy
+    template <class SimilarityPolicy>
+    void buildSimilarityGraphWith() {
+        adjList.clear();
+        adjList.resize(movies.size());
+        
+        for (int i = 0; i < movies.size(); i++) {
+            for (int j = i + 1; j < movies.size(); j++) {
+                double similarity = calculateSimilarity<SimilarityPolicy>(movies[i], sketches[i], movies[j], sketches[j]);
+                
+                // Add edge only if similarity is above threshold
+                if (similarity > SimilarityPolicy::edgeThreshold()) {
+                    adjList[i].push_back(make_pair(j, similarity));
+                    adjList[j].push_back(make_pair(i, similarity));
+                }
+            }
+        }
+    }
+    
+    // Estimate the memory (in bytes) of a k-NN similarity graph; the per-node
+    // heaps used during the build become the final adjacency rows
+    static size_t estimateKnnGraphMemory(size_t movieCount, int k) {
+        size_t rowLength = (movieCount > 0) ? min((size_t)k, movieCount - 1) : 0;
+        return movieCount * (sizeof(vector<pair<int, double> >) + rowLength * sizeof(pair<int, double>));
+    }
+    
+    // Build a similarity graph that keeps only the top k neighbors of each movie.
+    // Every node collects its neighbors in a bounded min-heap, so the dense graph
+    // is never materialized. Returns false if the graph would exceed the memory budget.
+    template <class SimilarityPolicy>
+    bool buildKnnSimilarityGraphWith(int k, size_t memoryBudget) {
+        if (k <= 0 || estimateKnnGraphMemory(movies.size(), k) > memoryBudget) {
+            return false;
+        }
+        
+        adjList.clear();
+        adjList.resize(movies.size());
+        
+        for (int i = 0; i < movies.size(); i++) {
+            adjList[i].reserve(min(k, (int)movies.size() - 1));
+        }
+        
+        for (int i = 0; i < movies.size(); i++) {
+            for (int j = i + 1; j < movies.size(); j++) {
+                double similarity = calculateSimilarity<SimilarityPolicy>(movies[i], sketches[i], movies[j], sketches[j]);
+                
+                if (similarity > SimilarityPolicy::edgeThreshold()) {
+                    pushBoundedNeighbor(adjList[i], j, similarity, k);
+                    pushBoundedNeighbor(adjList[j], i, similarity, k);
+                }
+            }
+        }
+        
+        // Turn each heap into a row sorted by similarity (highest first)
+        for (int i = 0; i < adjList.size(); i++) {
+            sort_heap(adjList[i].begin(), adjList[i].end(), compareBySimilarity);
+        }
+        
+        return true;
+    }
+    
+    // Build the similarity graph out of core. Movies are processed in blocks and
+    // their edges are buffered up to the memory limit, then sorted and spilled
+    // to temp files. The runs are k-way merged into the adjacency list, which
+    // keeps the top maxNeighbors edges of each movie (all of them if 0).
+    // Returns false if the graph does not fit in the memory limit or a temp file fails.
+    template <class SimilarityPolicy>
+    bool buildExternalSimilarityGraphWith(const ExternalBuildOptions& options) {
+        int movieCount = movies.size();
+        size_t rowBytes = movieCount * sizeof(vector<pair<int, double> >);
+        
+        // Nothing to pair up
+        if (movieCount < 2) {
+            adjList.clear();
+            adjList.resize(movieCount);
+            return true;
+        }
+        
+        if (options.maxNeighbors > 0 && 
+            estimateKnnGraphMemory(movieCount, options.maxNeighbors) > options.memoryLimit) {
+            return false;
+        }
+        
+        // Never reserve more than the number of directed edges the catalog can produce
+        size_t bufferCapacity = options.memoryLimit / sizeof(SimilarityEdge);
+        double maxEdges = (double)movieCount * (movieCount - 1);
+        if (bufferCapacity > maxEdges) bufferCapacity = (size_t)maxEdges;
+        if (bufferCapacity < 2) {
+            return false;
+        }
+        
+        adjList.clear();
+        EdgeRunStore runs(options.tempDirectory);
+        double startTime = currentTimeSeconds();
+        long long edgeCount = 0;
+        
+        {
+            vector<SimilarityEdge> buffer;
+            buffer.reserve(bufferCapacity);
+            int blockSize = max(1, options.blockSize);
+            int blockCount = (movieCount + blockSize - 1) / blockSize;
+            
+            for (int block = 0; block < blockCount; block++) {
+                int blockEnd = min(movieCount, (block + 1) * blockSize);
+                
+                for (int i = block * blockSize; i < blockEnd; i++) {
+                    for (int j = i + 1; j < movieCount; j++) {
+                        double similarity = calculateSimilarity<SimilarityPolicy>(movies[i], sketches[i], movies[j], sketches[j]);
+                        if (similarity <= SimilarityPolicy::edgeThreshold()) {
+                            continue;
+                        }
+                        
+                        if (buffer.size() + 2 > bufferCapacity) {
+                            if (!runs.writeRun(buffer)) return false;
+                            buffer.clear();
+                        }
+                        
+                        SimilarityEdge forward = { i, j, similarity };
+                        SimilarityEdge backward = { j, i, similarity };
+                        buffer.push_back(forward);
+                        buffer.push_back(backward);
+                        edgeCount += 2;
+                    }
+                }
+                
+                if (options.reportProgress) {
+                    double elapsed = currentTimeSeconds() - startTime;
+                    cout << "   Block " << (block + 1) << "/" << blockCount << ": " << blockEnd << " movies, "
+                         << edgeCount << " edges, " << runs.getRunCount() << " runs spilled, "
+                         << (long long)(edgeCount / max(elapsed, 0.001)) << " edges/s\n";
+                }
+            }
+            
+            if (!buffer.empty() && !runs.writeRun(buffer)) {
+                return false;
+            }
+        }
+        
+        // Merge the runs; edges arrive grouped by movie with the most similar first
+        EdgeRunMerger merger;
+        if (!runs.openMerger(merger)) {
+            return false;
+        }
+        
+        adjList.resize(movieCount);
+        size_t graphBytes = rowBytes;
+        vector<pair<int, double> > row;
+        int currentMovie = -1;
+        SimilarityEdge edge;
+        bool hasEdge = merger.next(edge);
+        
+        while (hasEdge || currentMovie != -1) {
+            if (!hasEdge || edge.from != currentMovie) {
+                if (currentMovie != -1) {
+                    graphBytes += row.size() * sizeof(pair<int, double>);
+                    if (graphBytes > options.memoryLimit) {
+                        adjList.clear();
+                        return false;
+                    }
+                    adjList[currentMovie].assign(row.begin(), row.end());
+                    row.clear();
+                }
+                currentMovie = hasEdge ? edge.from : -1;
+                if (!hasEdge) break;
+            }
+            
+            if (options.maxNeighbors <= 0 || (int)row.size() < options.maxNeighbors) {
+                row.push_back(make_pair(edge.to, edge.similarity));
+            }
+            hasEdge = merger.next(edge);
+        }
+        
+        if (options.reportProgress) {
+            double elapsed = currentTimeSeconds() - startTime;
+            cout << "   Merged " << edgeCount << " edges from " << runs.getRunCount() << " runs in "
+                 << elapsed << "s (" << (long long)(edgeCount / max(elapsed, 0.001)) << " edges/s, graph "
+                 << (graphBytes + 1023) / 1024 << " KB)\n";
+        }
+        
+        return true;
+    }
+    
+    // Build a similarity graph from LSH candidate pairs only: movies whose genre or cast
+    // signatures collide in at least one band. Pairs that share neither (and would only
+    // score on industry and rating) are skipped. Keeps the top maxNeighbors of each
+    // movie, or every edge if maxNeighbors is 0. Returns false if the candidate pairs
+    // and the graph together would exceed the memory budget.
+    template <class SimilarityPolicy>
+    bool buildLshSimilarityGraphWith(int maxNeighbors, int maxBucketWindow, size_t memoryBudget) {
+        adjList.clear();
+        
+        // A bounded graph has a known size, so reserve it from the budget up front
+        size_t graphBytes = (maxNeighbors > 0) ? estimateKnnGraphMemory(movies.size(), maxNeighbors)
+                                               : movies.size() * sizeof(vector<pair<int, double> >);
+        if (graphBytes > memoryBudget) {
+            return false;
+        }
+        
+        vector<unsigned long long> pairKeys;
+        if (!findLshCandidatePairs(maxBucketWindow, memoryBudget - graphBytes, pairKeys)) {
+            return false;
+        }
+        size_t keyBytes = pairKeys.size() * sizeof(unsigned long long);
+        
+        adjList.resize(movies.size());
+        for (int c = 0; c < pairKeys.size(); c++) {
+            int i = (int)(pairKeys[c] >> 32);
+            int j = (int)(pairKeys[c] & 0xffffffffULL);
+            double similarity = calculateSimilarity<SimilarityPolicy>(movies[i], sketches[i], movies[j], sketches[j]);
+            
+            if (similarity > SimilarityPolicy::edgeThreshold()) {
+                if (maxNeighbors > 0) {
+                    pushBoundedNeighbor(adjList[i], j, similarity, maxNeighbors);
+                    pushBoundedNeighbor(adjList[j], i, similarity, maxNeighbors);
+                }
+                else {
+                    graphBytes += 2 * sizeof(pair<int, double>);
+                    if (keyBytes + graphBytes > memoryBudget) {
+                        adjList.clear();
+                        return false;
+                    }
+                    adjList[i].push_back(make_pair(j, similarity));
+                    adjList[j].push_back(make_pair(i, similarity));
+                }
+            }
+        }
+        
+        if (maxNeighbors > 0) {
+            for (int i = 0; i < adjList.size(); i++) {
+                sort_heap(adjList[i].begin(), adjList[i].end(), compareBySimilarity);
+            }
+        }
+        return true;
+    }
+    
+    // Candidate pairs (i << 32 | j, i < j, sorted) whose genre or cast signatures agree on every
+    // row of some band. Buckets larger than maxBucketWindow (e.g. every movie of a popular genre)
+    // only pair each movie with the next maxBucketWindow movies by rating, the closest ratings.
+    // Each band's pairs are merged into the deduplicated set before the next band is hashed,
+    // so at most one band's duplicates are held at a time. Returns false if the pair keys
+    // would exceed the memory budget. Movies with no genres (or no cast) sit out that field.
+    bool findLshCandidatePairs(int maxBucketWindow, size_t memoryBudget, vector<unsigned long long>& pairKeys) {
+        size_t maxKeys = memoryBudget / sizeof(unsigned long long);
+        vector<pair<unsigned long long, int> > buckets;
+        pairKeys.clear();
+        
+        for (int field = 0; field < 2; field++) {
+            for (int band = 0; band < LSH_BANDS; band++) {
+                buckets.clear();
+                for (int i = 0; i < movies.size(); i++) {
+                    const MinHashSignature& signature = (field == 0) ? sketches[i].genres : sketches[i].cast;
+                    if (signature.empty) continue;
+                    
+                    unsigned long long key = band;
+                    for (int row = 0; row < LSH_ROWS; row++) {
+                        key = mixHash(key ^ signature.values[band * LSH_ROWS + row]);
+                    }
+                    buckets.push_back(make_pair(key, i));
+                }
+                sort(buckets.begin(), buckets.end());
+                int n = buckets.size();
+                
+                size_t bandStart = pairKeys.size();
+                for (int lo = 0; lo < n; ) {
+                    int hi = lo;
+                    while (hi < n && buckets[hi].first == buckets[lo].first) hi++;
+                    
+                    vector<int> members;
+                    for (int k = lo; k < hi; k++) {
+                        members.push_back(buckets[k].second);
+                    }
+                    if ((int)members.size() > maxBucketWindow + 1) {
+                        sort(members.begin(), members.end(), RatingOrder(movies));
+                    }
+                    
+                    for (int a = 0; a < members.size(); a++) {
+                        for (int b = a + 1; b < members.size() && b <= a + maxBucketWindow; b++) {
+                            if (pairKeys.size() >= maxKeys) {
+                                pairKeys.clear();
+                                return false;
+                            }
+                            unsigned long long first = min(members[a], members[b]);
+                            unsigned long long second = max(members[a], members[b]);
+                            pairKeys.push_back((first << 32) | second);
+                        }
+                    }
+                    lo = hi;
+                }
+                
+                sort(pairKeys.begin() + bandStart, pairKeys.end());
+                inplace_merge(pairKeys.begin(), pairKeys.begin() + bandStart, pairKeys.end());
+                pairKeys.erase(unique(pairKeys.begin(), pairKeys.end()), pairKeys.end());
+            }
+        }
+        
+        return true;
+    }
+    
+    // Add a neighbor to a heap that holds at most k entries, with the least similar neighbor on top
+    static void pushBoundedNeighbor(vector<pair<int, double> >& heap, int neighborId, double similarity, int k) {
+        if ((int)heap.size() < k) {
+            heap.push_back(make_pair(neighborId, similarity));
+            push_heap(heap.begin(), heap.end(), compareBySimilarity);
+        }
+        else if (!heap.empty() && similarity > heap.front().second) {
+            pop_heap(heap.begin(), heap.end(), compareBySimilarity);
+            heap.back() = make_pair(neighborId, similarity);
+            push_heap(heap.begin(), heap.end(), compareBySimilarity);
+        }
+    }
+    
+    // Score movies of a genre and industry by rating and graph similarity for several
+    // queries at once (highest first); their adjacency row scans are interleaved
+    vector<vector<pair<double, int> > > rankByGenreGraphBatch(const vector<GenreGraphQuery>& queries) {
+        vector<vector<pair<double, int> > > rankings(queries.size());
+        vector<GenreQueryCodes> queryCodes(queries.size());
+        vector<int> rows;
+        vector<int> workQuery;
+        
+        for (int q = 0; q < queries.size(); q++) {
+            map<string, vector<int> >::iterator genreIt = genreToMovies.find(queries[q].genre);
+            map<string, int>::iterator industryIt = industryCodes.find(queries[q].industry);
+            if (genreIt == genreToMovies.end() || industryIt == industryCodes.end()) {
+                continue;
+            }
+            
+            queryCodes[q].genre = genreCodes[queries[q].genre];
+            queryCodes[q].industry = industryIt->second;
+            
+            // Filter movies by industry first
+            const vector<int>& genreMovies = genreIt->second;
+            for (int i = 0; i < genreMovies.size(); i++) {
+                if (attributeCodes[genreMovies[i]].industry == queryCodes[q].industry) {
+                    rows.push_back(genreMovies[i]);
+                    workQuery.push_back(q);
+                }
+            }
+        }
+        
+        // Calculate average similarity for each movie within the genre and industry
+        GenreGraphScorer scorer(attributeCodes, genreCodeList, workQuery, queryCodes);
+        scanRowsInterleaved(rows, scorer);
+        
+        for (int w = 0; w < rows.size(); w++) {
+            // Combine rating and graph similarity
+            double score = movies[rows[w]].rating * 0.6 + scorer.averageSimilarity[w] * 4.0;
+            rankings[workQuery[w]].push_back(make_pair(score, rows[w]));
+        }
+        
+        for (int q = 0; q < queries.size(); q++) {
+            sort(rankings[q].begin(), rankings[q].end(), ScoreOrder(movies));
+            
+            // Take top N (none if topN is negative)
+            if ((int)rankings[q].size() > queries[q].topN) {
+                rankings[q].resize(max(queries[q].topN, 0));
+            }
+        }
+        
+        return rankings;
+    }
+    
+    // Score movies of a genre and industry by rating and graph similarity (highest first)
+    vector<pair<double, int> > rankByGenreGraph(const string& genre, const string& industry, int topN = 5) {
+        vector<GenreGraphQuery> queries(1, GenreGraphQuery(genre, industry, topN));
+        return rankByGenreGraphBatch(queries)[0];
+    }
+    
+    // Get genre-based recommendations for several genre and industry queries at once
+    vector<vector<Movie> > recommendByGenreGraphBatch(const vector<GenreGraphQuery>& queries) {
+        vector<vector<pair<double, int> > > rankings = rankByGenreGraphBatch(queries);
+        vector<vector<Movie> > recommendations(queries.size());
+        
+        for (int q = 0; q < rankings.size(); q++) {
+            for (int i = 0; i < rankings[q].size(); i++) {
+                recommendations[q].push_back(movies[rankings[q][i].second]);
+            }
+        }
+        
+        return recommendations;
+    }
+    
+    // Get genre-based recommendations using graph similarity for a specific industry
+    vector<Movie> recommendByGenreGraph(const string& genre, const string& industry, int topN = 5) {
+        vector<GenreGraphQuery> queries(1, GenreGraphQuery(genre, industry, topN));
+        return recommendByGenreGraphBatch(queries)[0];
+    }
+    
+    // Find similar movies to several movies at once; their adjacency row scans are interleaved
+    vector<vector<Movie> > findSimilarMoviesBatch(const vector<string>& movieTitles, int topN = 3) {
+        vector<vector<Movie> > recommendations(movieTitles.size());
+        vector<int> rows;
+        vector<int> workQuery;
+        
+        for (int q = 0; q < movieTitles.size(); q++) {
+            int editDistance;
+            int movieId = resolveMovieIndex(movieTitles[q], editDistance);
+            if (movieId != -1) {
+                rows.push_back(movieId);
+                workQuery.push_back(q);
+            }
+        }
+        
+        // Get directly connected movies with highest similarity
+        SimilarRowCollector collector(rows.size());
+        scanRowsInterleaved(rows, collector);
+        
+        for (int w = 0; w < rows.size(); w++) {
+            vector<pair<double, int> >& similarMovies = collector.rows[w];
+            sort(similarMovies.begin(), similarMovies.end(), ScoreOrder(movies));
+            
+            int count = min(topN, (int)similarMovies.size());
+            for (int i = 0; i < count; i++) {
+                recommendations[workQuery[w]].push_back(movies[similarMovies[i].second]);
+            }
+        }
+        
+        return recommendations;
+    }
+    
+    // Find similar movies to a given movie
+    vector<Movie> findSimilarMovies(const string& movieTitle, int topN = 3) {
+        vector<string> movieTitles(1, movieTitle);
+        return findSimilarMoviesBatch(movieTitles, topN)[0];
+    }
+    
+    // Score every movie against a movie that need not be in this recommender
+    // (e.g. one owned by another shard), keeping the ones above the edge threshold
+    template <class SimilarityPolicy>
+    vector<pair<double, int> > rankSimilarTo(const Movie& query, int topN) {
+        vector<pair<double, int> > similarMovies;
+        MovieSketch querySketch = MovieSketch::fromMovie(query);
+        
+        for (int i = 0; i < movies.size(); i++) {
+            if (movies[i].id == query.id) continue;
+            
+            double similarity = calculateSimilarity<SimilarityPolicy>(query, querySketch, movies[i], sketches[i]);
+            if (similarity > SimilarityPolicy::edgeThreshold()) {
+                similarMovies.push_back(make_pair(similarity, i));
+            }
+        }
+        
+        sort(similarMovies.begin(), similarMovies.end(), ScoreOrder(movies));
+        
+        if ((int)similarMovies.size() > topN) {
+            similarMovies.resize(max(topN, 0));
+        }
+        
+        return similarMovies;
+    }
+    
+    int getMovieCount() {
+        return movies.size();
+    }
+    
+    // Get movie index by title, -1 if unknown
+    int findMovieIndex(const string& movieTitle) {
+        map<string, int>::iterator it = titleToId.find(movieTitle);
+        return (it != titleToId.end()) ? it->second : -1;
+    }
+    
+    // Get movie index by exact title, or else by the closest title in the title index
+    int resolveMovieIndex(const string& movieTitle, int& editDistance) {
+        int index = findMovieIndex(movieTitle);
+        if (index != -1) {
+            editDistance = 0;
+            return index;
+        }
+        return titleIndex.findClosest(movieTitle, editDistance);
+    }
+    
+    Movie getMovieByIndex(int index) {
+        if (index >= 0 && index < movies.size()) {
+            return movies[index];
+        }
+        return Movie();
+    }
+    
+    // Get the current internal index of a movie by its external id, -1 if unknown
+    int findMovieIndexById(int movieId) {
+        map<int, int>::iterator it = idToIndex.find(movieId);
+        return (it != idToIndex.end()) ? it->second : -1;
+    }
+    
+    // Post-load renumbering pass for cache locality. External movie ids stay stable;
+    // use findMovieIndexById to map them to the new indices.
+    void reorderMovies(MovieOrdering ordering) {
+        if (ordering == ORDER_BY_RCM) {
+            applyOrdering(computeRcmOrder());
+        }
+        else {
+            applyOrdering(computeAttributeOrder());
+        }
+    }
+};
+
+// Registry of the prebuilt similarity policies, so the policy can be chosen at startup
+class SimilarityPolicyRegistry {
+public:
+    typedef void (GraphBasedRecommender::*BuildFunction)();
+    typedef bool (GraphBasedRecommender::*KnnBuildFunction)(int, size_t);
+    typedef bool (GraphBasedRecommender::*ExternalBuildFunction)(const ExternalBuildOptions&);
+    typedef vector<pair<double, int> > (GraphBasedRecommender::*RankFunction)(const Movie&, int);
+    typedef bool (GraphBasedRecommender::*LshBuildFunction)(int, int, size_t);
+    
+    // Graph builders specialized for one policy
+    struct PolicyBuilders {
+        BuildFunction build;
+        KnnBuildFunction buildKnn;
+        ExternalBuildFunction buildExternal;
+        RankFunction rankSimilarTo;
+        LshBuildFunction buildLsh;
+    };
+    
+private:
+    map<string, PolicyBuilders> builders;
+    
+public:
+    template <class SimilarityPolicy>
+    void registerPolicy(const string& name) {
+        PolicyBuilders policyBuilders;
+        policyBuilders.build = &GraphBasedRecommender::buildSimilarityGraphWith<SimilarityPolicy>;
+        policyBuilders.buildKnn = &GraphBasedRecommender::buildKnnSimilarityGraphWith<SimilarityPolicy>;
+        policyBuilders.buildExternal = &GraphBasedRecommender::buildExternalSimilarityGraphWith<SimilarityPolicy>;
+        policyBuilders.rankSimilarTo = &GraphBasedRecommender::rankSimilarTo<SimilarityPolicy>;
+        policyBuilders.buildLsh = &GraphBasedRecommender::buildLshSimilarityGraphWith<SimilarityPolicy>;
+        builders[name] = policyBuilders;
+    }
+    
+    bool hasPolicy(const string& name) {
+        return builders.find(name) != builders.end();
+    }
+    
+    vector<string> getPolicyNames() {
+        vector<string> names;
+        map<string, PolicyBuilders>::iterator it;
+        for (it = builders.begin(); it != builders.end(); ++it) {
+            names.push_back(it->first);
+        }
+        return names;
+    }
+    
+    // Build the similarity graph of the recommender with the named policy
+    bool buildSimilarityGraph(const string& name, GraphBasedRecommender& recommender) {
+        if (!hasPolicy(name)) {
+            return false;
+        }
+        (recommender.*builders[name].build)();
+        return true;
+    }
+    
+    // Build a top-k similarity graph of the recommender with the named policy
+    bool buildKnnSimilarityGraph(const string& name, GraphBasedRecommender& recommender, int k, size_t memoryBudget) {
+        if (!hasPolicy(name)) {
+            return false;
+        }
+        return (recommender.*builders[name].buildKnn)(k, memoryBudget);
+    }
+    
+    // Build the similarity graph of the recommender out of core with the named policy
+    bool buildExternalSimilarityGraph(const string& name, GraphBasedRecommender& recommender, 
+                                      const ExternalBuildOptions& options) {
+        if (!hasPolicy(name)) {
+            return false;
+        }
+        return (recommender.*builders[name].buildExternal)(options);
+    }
+    
+    // Build the similarity graph of the recommender from LSH candidate pairs with the named policy
+    bool buildLshSimilarityGraph(const string& name, GraphBasedRecommender& recommender, 
+                                 int maxNeighbors, int maxBucketWindow, size_t memoryBudget) {
+        if (!hasPolicy(name)) {
+            return false;
+        }
+        return (recommender.*builders[name].buildLsh)(maxNeighbors, maxBucketWindow, memoryBudget);
+    }
+    
+    // Get the function that ranks movies against an outside movie with the named policy
+    RankFunction getRankFunction(const string& name) {
+        if (!hasPolicy(name)) {
+            return NULL;
+        }
+        return builders[name].rankSimilarTo;
+    }
+    
+    static SimilarityPolicyRegistry createDefault() {
+        SimilarityPolicyRegistry registry;
+        registry.registerPolicy<DefaultSimilarityPolicy>("default");
+        registry.registerPolicy<GenreFocusedSimilarityPolicy>("genre");
+        registry.registerPolicy<ActorFocusedSimilarityPolicy>("actor");
+        registry.registerPolicy<CrossIndustrySimilarityPolicy>("cross-industry");
+        return registry;
+    }
+};
+
+// How the similarity graph is built, as chosen on the command line
+struct GraphBuildOptions {
+    string similarityPolicy;
+    int knnNeighbors;      // 0 builds the full similarity graph
+    size_t memoryBudget;   // bytes for the k-NN and out-of-core builds
+    bool externalBuild;
+    bool lshBuild;
+    ExternalBuildOptions externalOptions;
+    string reorder;        // "none", "attributes" or "rcm"
+    
+    GraphBuildOptions() : similarityPolicy("default"), knnNeighbors(0), memoryBudget(1024 * 1024 * 1024), 
+                          externalBuild(false), lshBuild(false), reorder("none") {}
+};
+
+// Build the similarity graph of the recommender, then renumber its movies for cache locality.
+// With reportProgress the build describes itself and its failures on cout.
+bool buildGraphRecommender(SimilarityPolicyRegistry& policyRegistry, GraphBasedRecommender& recommender, 
+                           const GraphBuildOptions& options, bool reportProgress) {
+    int memoryBudgetMB = options.memoryBudget / (1024 * 1024);
+    
+    if (options.externalBuild) {
+        ExternalBuildOptions externalOptions = options.externalOptions;
+        externalOptions.memoryLimit = options.memoryBudget;
+        externalOptions.maxNeighbors = options.knnNeighbors;
+        externalOptions.reportProgress = reportProgress;
+        if (reportProgress) {
+            cout << "Building similarity graph out of core in " << externalOptions.tempDirectory
+                 << " (memory limit " << memoryBudgetMB << " MB):\n";
+        }
+        
+        if (!policyRegistry.buildExternalSimilarityGraph(options.similarityPolicy, recommender, externalOptions)) {
+            if (reportProgress) cout << "Out-of-core similarity graph build failed!\n";
+            return false;
+        }
+    }
+    else if (options.lshBuild) {
+        if (reportProgress && options.knnNeighbors > 0) {
+            size_t estimate = GraphBasedRecommender::estimateKnnGraphMemory(recommender.getMovieCount(), options.knnNeighbors);
+            cout << "LSH Graph: " << options.knnNeighbors << " neighbors per movie, estimated "
+                 << (estimate + 1023) / 1024 << " KB plus candidate pairs (budget " << memoryBudgetMB << " MB)\n";
+        }
+        
+        // Oversized LSH buckets pair each movie with its 64 closest-rated bucket mates
+        if (!policyRegistry.buildLshSimilarityGraph(options.similarityPolicy, recommender, 
+                                                    options.knnNeighbors, 64, options.memoryBudget)) {
+            if (reportProgress) cout << "Similarity graph does not fit in the memory budget!\n";
+            return false;
+        }
+    }
+    else if (options.knnNeighbors > 0) {
+        if (reportProgress) {
+            size_t estimate = GraphBasedRecommender::estimateKnnGraphMemory(recommender.getMovieCount(), options.knnNeighbors);
+            cout << "k-NN Graph: " << options.knnNeighbors << " neighbors per movie, estimated "
+                 << (estimate + 1023) / 1024 << " KB (budget " << memoryBudgetMB << " MB)\n";
+        }
+        
+        if (!policyRegistry.buildKnnSimilarityGraph(options.similarityPolicy, recommender, 
+                                                    options.knnNeighbors, options.memoryBudget)) {
+            if (reportProgress) cout << "Similarity graph does not fit in the memory budget!\n";
+            return false;
+        }
+    }
+    else {
+        policyRegistry.buildSimilarityGraph(options.similarityPolicy, recommender);
+    }
+    
+    if (options.reorder == "attributes") {
+        recommender.reorderMovies(ORDER_BY_ATTRIBUTES);
+    }
+    else if (options.reorder == "rcm") {
+        recommender.reorderMovies(ORDER_BY_RCM);
+    }
+    return true;
+}
+
+// ============ SHARDED SERVING ============
+// The catalog is partitioned across worker processes that each own the indexes
+// and the similarity graph of their slice. A coordinator fans every query out
+// over local sockets and merges the per-shard top-K lists.
+//
+// Wire format: one tab-separated request per line. A response is a line with
+// the result count followed by one "score, movie fields" line per result.
+
+enum ShardPartition {
+    PARTITION_BY_INDUSTRY, // exact graph recommendations, since they never cross industries
+    PARTITION_BY_HASH      // even shard sizes; graph scores only see same-shard neighbors
+};
+
+// Comparison for merging scored movies from several shards, with the same tie-break as ScoreOrder
+bool compareScoredMovies(const pair<double, Movie>& a, const pair<double, Movie>& b) {
+    double scoreA = quantizeScore(a.first);
+    double scoreB = quantizeScore(b.first);
+    if (scoreA != scoreB) {
+        return scoreA > scoreB;
+    }
+    return a.second.id < b.second.id;
+}
+
+vector<string> splitFields(const string& line) {
+    vector<string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find('\t', start);
+        if (tab == string::npos) {
+            fields.push_back(line.substr(start));
+            return fields;
+        }
+        fields.push_back(line.substr(start, tab - start));
+        start = tab + 1;
+    }
+}
+
+// Genre and cast lists travel as a single field separated by '|'
+string joinList(const vector<string>& items) {
+    string joined;
+    for (int i = 0; i < items.size(); i++) {
+        if (i > 0) joined += '|';
+        joined += items[i];
+    }
+    return joined;
+}
+
+vector<string> splitList(const string& joined) {
+    vector<string> items;
+    size_t start = 0;
+    while (start <= joined.size()) {
+        size_t bar = joined.find('|', start);
+        if (bar == string::npos) bar = joined.size();
+        items.push_back(joined.substr(start, bar - start));
+        start = bar + 1;
+    }
+    return items;
+}
+
+string formatMovieFields(const Movie& movie) {
+    ostringstream out;
+    out.precision(17);
+    out << movie.id << '\t' << movie.title << '\t' << movie.genre << '\t' 
+        << movie.actor << '\t' << movie.rating << '\t' << movie.industry << '\t'
+        << joinList(movie.genres) << '\t' << joinList(movie.cast);
+    return out.str();
+}
+
+// Parse the eight movie fields starting at fields[start]
+bool parseMovieFields(const vector<string>& fields, int start, Movie& movie) {
+    if ((int)fields.size() < start + 8) {
+        return false;
+    }
+    movie = Movie(atoi(fields[start].c_str()), fields[start + 1], splitList(fields[start + 6]), 
+                  splitList(fields[start + 7]), strtod(fields[start + 4].c_str(), NULL), fields[start + 5]);
+    return true;
+}
+
+// Write the whole buffer to a socket
+bool sendAll(int socket, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+// Buffered line reader over a socket
+class LineReader {
+private:
+    int socket;
+    string buffer;
+    
+public:
+    LineReader(int socket) : socket(socket) {}
+    
+    bool readLine(string& line) {
+        while (true) {
+            size_t newline = buffer.find('\n');
+            if (newline != string::npos) {
+                line = buffer.substr(0, newline);
+                buffer.erase(0, newline + 1);
+                return true;
+            }
+            
+            char chunk[4096];
+            ssize_t n = recv(socket, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            buffer.append(chunk, n);
+        }
     }
+};
+
+// Worker process state: the recommenders over one slice of the catalog
+class ShardWorker {
+private:
+    ContentBasedRecommender contentRecommender;
+    GraphBasedRecommender graphRecommender;
+    SimilarityPolicyRegistry policyRegistry;
+    GraphBuildOptions buildOptions;
     
-    // Recommend movies by genre and industry (top rated)
-    vector<Movie> recommendByGenreAndIndustry(const string& genre, const string& industry, int topN = 5) {
-        vector<Movie> recommendations;
-        
-        if (genreToMovies.find(genre) == genreToMovies.end()) {
-            return recommendations;
+    string formatResponse(const vector<pair<double, Movie> >& results) {
+        ostringstream out;
+        out.precision(17);
+        out << results.size() << '\n';
+        for (int i = 0; i < results.size(); i++) {
+            out << results[i].first << '\t' << formatMovieFields(results[i].second) << '\n';
         }
-        
-        vector<int> genreMovies = genreToMovies[genre];
-        
-        // Create a vector of rating-index pairs for sorting
-        vector<pair<double, int> > ratingPairs;
-        
-        for (int i = 0; i < genreMovies.size(); i++) {
-            int idx = genreMovies[i];
-            if (movies[idx].industry == industry) {
-                ratingPairs.push_back(make_pair(movies[idx].rating, idx));
+        return out.str();
+    }
+    
+    // One "first movie id, genre" line per genre, so the coordinator can restore catalog order
+    string formatGenres(const string& industry) {
+        vector<string> genres = contentRecommender.getGenresByIndustry(industry);
+        ostringstream out;
+        out << genres.size() << '\n';
+        for (int i = 0; i < genres.size(); i++) {
+            vector<Movie> genreMovies = contentRecommender.getMoviesByGenreAndIndustry(genres[i], industry);
+            int firstId = INT_MAX;
+            for (int j = 0; j < genreMovies.size(); j++) {
+                firstId = min(firstId, genreMovies[j].id);
             }
+            out << firstId << '\t' << genres[i] << '\n';
         }
-        
-        // Sort by rating (highest first)
-        sort(ratingPairs.begin(), ratingPairs.end(), compareByRating);
-        
-        // Take top N
-        for (int i = 0; i < min(topN, (int)ratingPairs.size()); i++) {
-            recommendations.push_back(movies[ratingPairs[i].second]);
-        }
-        
-        return recommendations;
+        return out.str();
     }
     
-    // Recommend movies by actor
-    vector<Movie> recommendByActor(const string& actor, int topN = 5) {
-        vector<Movie> recommendations;
-        
-        if (actorToMovies.find(actor) == actorToMovies.end()) {
-            return recommendations;
-        }
-        
-        vector<int> actorMovies = actorToMovies[actor];
-        
-        // Create a vector of rating-index pairs for sorting
-        vector<pair<double, int> > ratingPairs;
-        
-        for (int i = 0; i < actorMovies.size(); i++) {
-            int idx = actorMovies[i];
-            ratingPairs.push_back(make_pair(movies[idx].rating, idx));
-        }
-        
-        // Sort by rating (highest first)
-        sort(ratingPairs.begin(), ratingPairs.end(), compareByRating);
-        
-        // Take top N
-        for (int i = 0; i < min(topN, (int)ratingPairs.size()); i++) {
-            recommendations.push_back(movies[ratingPairs[i].second]);
+    // One "actor, movie count, rating sum" line per lead actor in the genre
+    string formatGenreActors(const string& genre, const string& industry) {
+        map<string, int> actorCount;
+        map<string, double> actorRatingSum;
+        countActors(contentRecommender.getMoviesByGenreAndIndustry(genre, industry), actorCount, actorRatingSum);
+        
+        ostringstream out;
+        out.precision(17);
+        out << actorCount.size() << '\n';
+        map<string, int>::iterator it;
+        for (it = actorCount.begin(); it != actorCount.end(); ++it) {
+            out << it->first << '\t' << it->second << '\t' << actorRatingSum[it->first] << '\n';
         }
-        
-        return recommendations;
+        return out.str();
     }
     
-    int getMovieCount() {
-        return movies.size();
+    void addRatedMovies(const vector<Movie>& movies, vector<pair<double, Movie> >& results) {
+        for (int i = 0; i < movies.size(); i++) {
+            results.push_back(make_pair(movies[i].rating, movies[i]));
+        }
     }
     
-    string getMovieTitle(int index) {
-        if (index >= 0 && index < movies.size()) {
-            return movies[index].title;
+    void addRankedMovies(const vector<pair<double, int> >& ranked, vector<pair<double, Movie> >& results) {
+        for (int i = 0; i < ranked.size(); i++) {
+            results.push_back(make_pair(ranked[i].first, graphRecommender.getMovieByIndex(ranked[i].second)));
         }
-        return "";
     }
     
-    Movie getMovieByIndex(int index) {
-        if (index >= 0 && index < movies.size()) {
-            return movies[index];
-        }
-        return Movie();
+public:
+    ShardWorker(const GraphBuildOptions& buildOptions) 
+        : policyRegistry(SimilarityPolicyRegistry::createDefault()), buildOptions(buildOptions) {}
+    
+    void addMovie(const Movie& movie) {
+        contentRecommender.addMovie(movie);
+        graphRecommender.addMovie(movie);
     }
     
-    // Get movie by title
-    Movie getMovieByTitle(const string& title) {
-        int idx = findMovieIndex(title);
-        if (idx != -1) {
-            return movies[idx];
+    bool buildSimilarityGraph() {
+        return buildGraphRecommender(policyRegistry, graphRecommender, buildOptions, false);
+    }
+    
+    // Answer requests until the coordinator closes the socket
+    void serve(int socket) {
+        SimilarityPolicyRegistry::RankFunction rankSimilarTo = policyRegistry.getRankFunction(buildOptions.similarityPolicy);
+        LineReader reader(socket);
+        string line;
+        
+        while (reader.readLine(line)) {
+            vector<string> fields = splitFields(line);
+            vector<pair<double, Movie> > results;
+            const string& command = fields[0];
+            
+            if (command == "GENRES" && fields.size() == 2) {
+                if (!sendAll(socket, formatGenres(fields[1]))) return;
+                continue;
+            }
+            if (command == "GENRE_ACTORS" && fields.size() == 3) {
+                if (!sendAll(socket, formatGenreActors(fields[1], fields[2]))) return;
+                continue;
+            }
+            
+            if (command == "TOP_RATED" && fields.size() == 4) {
+                addRatedMovies(contentRecommender.recommendByGenreAndIndustry(fields[1], fields[2], atoi(fields[3].c_str())), results);
+            }
+            else if (command == "ACTOR" && fields.size() == 3) {
+                addRatedMovies(contentRecommender.recommendByActor(fields[1], atoi(fields[2].c_str())), results);
+            }
+            else if (command == "GRAPH" && fields.size() == 4) {
+                addRankedMovies(graphRecommender.rankByGenreGraph(fields[1], fields[2], atoi(fields[3].c_str())), results);
+            }
+            else if (command == "LOOKUP" && fields.size() == 2) {
+                // Score by negated edit distance so the coordinator prefers the closest title
+                int editDistance;
+                int index = graphRecommender.resolveMovieIndex(fields[1], editDistance);
+                if (index != -1) {
+                    results.push_back(make_pair(-(double)editDistance, graphRecommender.getMovieByIndex(index)));
+                }
+            }
+            else if (command == "SIMILAR" && fields.size() == 10) {
+                Movie query;
+                parseMovieFields(fields, 2, query);
+                addRankedMovies((graphRecommender.*rankSimilarTo)(query, atoi(fields[1].c_str())), results);
+            }
+            
+            if (!sendAll(socket, formatResponse(results))) {
+                return;
+            }
         }
-        return Movie();
     }
 };
 
-// Graph-Based Recommendation System
-class GraphBasedRecommender {
+// Coordinator: forks one worker process per shard and scatter-gathers queries
+class ShardCoordinator {
 private:
-    vector<Movie> movies;
-    vector<vector<pair<int, double> > > adjList; // adjacency list with similarity scores
-    map<string, int> titleToId;
-    map<string, vector<int> > genreToMovies;
-    
-    // Calculate similarity between two movies
-    double calculateSimilarity(const Movie& m1, const Movie& m2) {
-        double similarity = 0.0;
-        
-        // Genre similarity (30% weight)
-        if (m1.genre == m2.genre) similarity += 0.3;
-        
-        // Actor similarity (30% weight)
-        if (m1.actor == m2.actor) similarity += 0.3;
-        
-        // Industry similarity (20% weight)
-        if (m1.industry == m2.industry) similarity += 0.2;
-        
-        // Rating similarity (20% weight) - closer ratings mean higher similarity
-        double ratingDiff = fabs(m1.rating - m2.rating) / 10.0;
-        similarity += 0.2 * (1.0 - ratingDiff);
-        
-        return similarity;
-    }
+    vector<int> shardSockets;
+    vector<pid_t> workerPids;
     
-public:
-    void addMovie(const Movie& movie) {
-        int id = movies.size();
-        movies.push_back(movie);
-        titleToId[movie.title] = id;
-        genreToMovies[movie.genre].push_back(id);
+    static int countIndustries(const vector<Movie>& movies) {
+        map<string, bool> industries;
+        for (int i = 0; i < movies.size(); i++) {
+            industries[movies[i].industry] = true;
+        }
+        return industries.size();
     }
     
-    // Build similarity graph between all movies
-    void buildSimilarityGraph() {
-        adjList.clear();
-        adjList.resize(movies.size());
+    // Assign every movie to a shard. Industry partitioning needs shardCount <= the number of industries.
+    static vector<int> partitionMovies(const vector<Movie>& movies, int shardCount, ShardPartition partition) {
+        vector<int> shardOf(movies.size());
+        map<string, int> industryShard;
         
         for (int i = 0; i < movies.size(); i++) {
-            for (int j = i + 1; j < movies.size(); j++) {
-                double similarity = calculateSimilarity(movies[i], movies[j]);
-                
-                // Add edge only if similarity is above threshold
-                if (similarity > 0.2) {
-                    adjList[i].push_back(make_pair(j, similarity));
-                    adjList[j].push_back(make_pair(i, similarity));
+            if (partition == PARTITION_BY_INDUSTRY) {
+                if (industryShard.find(movies[i].industry) == industryShard.end()) {
+                    int nextShard = industryShard.size() % shardCount;
+                    industryShard[movies[i].industry] = nextShard;
                 }
+                shardOf[i] = industryShard[movies[i].industry];
+            }
+            else {
+                // Multiplicative hash of the movie id
+                shardOf[i] = (int)(((unsigned int)movies[i].id * 2654435761u) % shardCount);
             }
         }
+        return shardOf;
     }
     
-    // Get genre-based recommendations using graph similarity for a specific industry
-    vector<Movie> recommendByGenreGraph(const string& genre, const string& industry, int topN = 5) {
-        vector<Movie> recommendations;
-        
-        if (genreToMovies.find(genre) == genreToMovies.end()) {
-            return recommendations;
+    // A shard that dropped its connection (or a response) is closed for good,
+    // since its socket can no longer be kept in step with the requests
+    void markShardFailed(int shard) {
+        if (shardSockets[shard] != -1) {
+            close(shardSockets[shard]);
+            shardSockets[shard] = -1;
+        }
+    }
+    
+    // Read one response; false if the shard failed before sending all of it
+    bool readResponse(int shard, vector<vector<string> >& responseFields) {
+        LineReader reader(shardSockets[shard]);
+        string line;
+        if (!reader.readLine(line)) {
+            return false;
         }
         
-        vector<int> genreMovies = genreToMovies[genre];
+        int count = atoi(line.c_str());
+        for (int i = 0; i < count; i++) {
+            if (!reader.readLine(line)) {
+                return false;
+            }
+            responseFields.push_back(splitFields(line));
+        }
+        return true;
+    }
+    
+    // Send the request to every shard and collect the fields of all their response lines.
+    // Lines missing because of a failed shard are reported, not silently dropped.
+    vector<vector<string> > scatterGatherFields(const string& request) {
+        vector<vector<string> > responseFields;
+        vector<bool> sent(shardSockets.size());
+        
+        for (int shard = 0; shard < shardSockets.size(); shard++) {
+            sent[shard] = shardSockets[shard] != -1 && sendAll(shardSockets[shard], request + "\n");
+        }
         
-        // Filter movies by industry first
-        vector<int> industryGenreMovies;
-        for (int i = 0; i < genreMovies.size(); i++) {
-            int movieId = genreMovies[i];
-            if (movies[movieId].industry == industry) {
-                industryGenreMovies.push_back(movieId);
+        for (int shard = 0; shard < shardSockets.size(); shard++) {
+            if (!sent[shard] || !readResponse(shard, responseFields)) {
+                markShardFailed(shard);
+                cout << "Warning: shard " << (shard + 1) << " is not responding, results are incomplete!\n";
+            }
+        }
+        return responseFields;
+    }
+    
+    // Scatter-gather scored movies and merge them (highest score first)
+    vector<pair<double, Movie> > scatterGather(const string& request, int topN) {
+        vector<vector<string> > responseFields = scatterGatherFields(request);
+        vector<pair<double, Movie> > merged;
+        
+        for (int i = 0; i < responseFields.size(); i++) {
+            Movie movie;
+            if (parseMovieFields(responseFields[i], 1, movie)) {
+                merged.push_back(make_pair(strtod(responseFields[i][0].c_str(), NULL), movie));
             }
         }
         
-        if (industryGenreMovies.empty()) return recommendations;
+        sort(merged.begin(), merged.end(), compareScoredMovies);
+        if ((int)merged.size() > topN) {
+            merged.resize(max(topN, 0));
+        }
+        return merged;
+    }
+    
+    vector<Movie> scatterGatherMovies(const string& request, int topN) {
+        vector<pair<double, Movie> > scored = scatterGather(request, topN);
+        vector<Movie> result;
+        for (int i = 0; i < scored.size(); i++) {
+            result.push_back(scored[i].second);
+        }
+        return result;
+    }
+    
+public:
+    ~ShardCoordinator() {
+        stop();
+    }
+    
+    // Fork the worker processes; each one builds the recommenders of its own partition
+    // and reports whether its graph build succeeded before serving requests
+    bool start(const vector<Movie>& movies, int shardCount, ShardPartition partition, const GraphBuildOptions& buildOptions) {
+        // An industry never spans shards, so extra shards would sit empty
+        if (partition == PARTITION_BY_INDUSTRY) {
+            shardCount = min(shardCount, max(countIndustries(movies), 1));
+        }
+        vector<int> shardOf = partitionMovies(movies, shardCount, partition);
         
-        // Calculate average similarity for each movie within the genre and industry
-        vector<pair<double, int> > movieScores;
+        // The workers build at the same time, so they split the memory budget
+        GraphBuildOptions workerOptions = buildOptions;
+        workerOptions.memoryBudget /= shardCount;
         
-        for (int i = 0; i < industryGenreMovies.size(); i++) {
-            int movieId = industryGenreMovies[i];
-            double totalSimilarity = 0.0;
-            int similarCount = 0;
+        for (int shard = 0; shard < shardCount; shard++) {
+            int sockets[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == -1) {
+                stop();
+                return false;
+            }
             
-            for (int j = 0; j < adjList[movieId].size(); j++) {
-                int neighborId = adjList[movieId][j].first;
-                if (movies[neighborId].genre == genre && movies[neighborId].industry == industry) {
-                    totalSimilarity += adjList[movieId][j].second;
-                    similarCount++;
+            cout.flush();
+            pid_t pid = fork();
+            if (pid == -1) {
+                close(sockets[0]);
+                close(sockets[1]);
+                stop();
+                return false;
+            }
+            
+            if (pid == 0) {
+                // Worker process
+                close(sockets[0]);
+                for (int i = 0; i < shardSockets.size(); i++) {
+                    close(shardSockets[i]);
+                }
+                
+                ShardWorker worker(workerOptions);
+                for (int i = 0; i < movies.size(); i++) {
+                    if (shardOf[i] == shard) {
+                        worker.addMovie(movies[i]);
+                    }
                 }
+                if (!worker.buildSimilarityGraph()) {
+                    sendAll(sockets[1], "FAILED\n");
+                    close(sockets[1]);
+                    _exit(1);
+                }
+                sendAll(sockets[1], "READY\n");
+                worker.serve(sockets[1]);
+                close(sockets[1]);
+                _exit(0);
             }
             
-            double avgSimilarity = (similarCount > 0) ? totalSimilarity / similarCount : 0.0;
-            // Combine rating and graph similarity
-            double score = movies[movieId].rating * 0.6 + avgSimilarity * 4.0;
-            movieScores.push_back(make_pair(score, movieId));
+            close(sockets[1]);
+            shardSockets.push_back(sockets[0]);
+            workerPids.push_back(pid);
         }
         
-        sort(movieScores.begin(), movieScores.end(), compareByRating);
-        
-        // Take top N
-        for (int i = 0; i < min(topN, (int)movieScores.size()); i++) {
-            recommendations.push_back(movies[movieScores[i].second]);
+        for (int shard = 0; shard < shardSockets.size(); shard++) {
+            LineReader reader(shardSockets[shard]);
+            string line;
+            if (!reader.readLine(line) || line != "READY") {
+                stop();
+                return false;
+            }
         }
-        
-        return recommendations;
+        return true;
     }
     
-    // Find similar movies to a given movie
-    vector<Movie> findSimilarMovies(const string& movieTitle, int topN = 3) {
-        vector<Movie> recommendations;
-        
-        if (titleToId.find(movieTitle) == titleToId.end()) {
-            return recommendations;
+    // Close the sockets and wait for the workers to exit
+    void stop() {
+        for (int i = 0; i < shardSockets.size(); i++) {
+            if (shardSockets[i] != -1) close(shardSockets[i]);
+        }
+        for (int i = 0; i < workerPids.size(); i++) {
+            waitpid(workerPids[i], NULL, 0);
+        }
+        shardSockets.clear();
+        workerPids.clear();
+    }
+    
+    int getShardCount() {
+        return shardSockets.size();
+    }
+    
+    // Genres of an industry in catalog order (by the first movie id of each genre)
+    vector<string> getGenresByIndustry(const string& industry) {
+        vector<vector<string> > responseFields = scatterGatherFields("GENRES\t" + industry);
+        map<string, int> firstId;
+        
+        for (int i = 0; i < responseFields.size(); i++) {
+            if (responseFields[i].size() != 2) continue;
+            int id = atoi(responseFields[i][0].c_str());
+            const string& genre = responseFields[i][1];
+            if (firstId.find(genre) == firstId.end() || id < firstId[genre]) {
+                firstId[genre] = id;
+            }
         }
         
-        int movieId = titleToId[movieTitle];
-        
-        // Get directly connected movies with highest similarity
-        vector<pair<double, int> > similarMovies;
-        
-        for (int i = 0; i < adjList[movieId].size(); i++) {
-            int neighborId = adjList[movieId][i].first;
-            double similarity = adjList[movieId][i].second;
-            similarMovies.push_back(make_pair(similarity, neighborId));
+        vector<pair<int, string> > ordered;
+        map<string, int>::iterator it;
+        for (it = firstId.begin(); it != firstId.end(); ++it) {
+            ordered.push_back(make_pair(it->second, it->first));
         }
+        sort(ordered.begin(), ordered.end());
         
-        sort(similarMovies.begin(), similarMovies.end(), compareByRating);
+        vector<string> genres;
+        for (int i = 0; i < ordered.size(); i++) {
+            genres.push_back(ordered[i].second);
+        }
+        return genres;
+    }
+    
+    // Merge the per-shard lead actor counts of a genre; returns the number of movies counted
+    int countGenreActors(const string& genre, const string& industry, 
+                         map<string, int>& actorCount, map<string, double>& actorRatingSum) {
+        vector<vector<string> > responseFields = scatterGatherFields("GENRE_ACTORS\t" + genre + "\t" + industry);
+        int movieCount = 0;
+        
+        for (int i = 0; i < responseFields.size(); i++) {
+            if (responseFields[i].size() != 3) continue;
+            const string& actor = responseFields[i][0];
+            int count = atoi(responseFields[i][1].c_str());
+            actorCount[actor] += count;
+            actorRatingSum[actor] += strtod(responseFields[i][2].c_str(), NULL);
+            movieCount += count;
+        }
+        return movieCount;
+    }
+    
+    vector<Movie> recommendByGenreAndIndustry(const string& genre, const string& industry, int topN = 5) {
+        ostringstream request;
+        request << "TOP_RATED\t" << genre << '\t' << industry << '\t' << topN;
+        return scatterGatherMovies(request.str(), topN);
+    }
+    
+    vector<Movie> recommendByActor(const string& actor, int topN = 5) {
+        ostringstream request;
+        request << "ACTOR\t" << actor << '\t' << topN;
+        return scatterGatherMovies(request.str(), topN);
+    }
+    
+    vector<Movie> recommendByGenreGraph(const string& genre, const string& industry, int topN = 5) {
+        ostringstream request;
+        request << "GRAPH\t" << genre << '\t' << industry << '\t' << topN;
+        return scatterGatherMovies(request.str(), topN);
+    }
+    
+    // Look the movie up on its owning shard, then rank every shard's movies against it
+    vector<Movie> findSimilarMovies(const string& movieTitle, int topN = 3) {
+        vector<pair<double, Movie> > found = scatterGather("LOOKUP\t" + movieTitle, INT_MAX);
+        if (found.empty()) {
+            return vector<Movie>();
+        }
         
-        for (int i = 0; i < min(topN, (int)similarMovies.size()); i++) {
-            recommendations.push_back(movies[similarMovies[i].second]);
+        // Closest title wins; duplicates resolve to the last added movie, like GraphBasedRecommender
+        Movie query = found[0].second;
+        for (int i = 1; i < found.size() && found[i].first == found[0].first; i++) {
+            if (found[i].second.id > query.id) query = found[i].second;
         }
         
-        return recommendations;
+        ostringstream request;
+        request << "SIMILAR\t" << topN << '\t' << formatMovieFields(query);
+        return scatterGatherMovies(request.str(), topN);
     }
 };
 
@@ -382,18 +2469,10 @@ void displayRecommendations(const vector<Movie>& recommendations, const string&
     }
 }
 
-// Function to display popular actors in a genre for a specific industry
-void displayPopularActors(const string& genre, const vector<Movie>& genreMovies, int displayCount = 3) {
-    // Count movies by actor in this genre
-    map<string, int> actorCount;
-    map<string, double> actorRatingSum;
-    
-    for (int i = 0; i < genreMovies.size(); i++) {
-        Movie m = genreMovies[i];
-        actorCount[m.actor]++;
-        actorRatingSum[m.actor] += m.rating;
-    }
-    
+// Function to display popular actors in a genre for a specific industry,
+// from the movie counts and rating sums of the genre's lead actors
+void displayPopularActors(const string& genre, map<string, int>& actorCount, 
+                          map<string, double>& actorRatingSum, int displayCount = 3) {
     // Display top actors in this genre
     vector<pair<double, string> > topActors;
     map<string, int>::iterator it;
@@ -421,7 +2500,67 @@ void clearInputStream() {
     cin.ignore(10000, '\n');
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Parse command line options
+    GraphBuildOptions buildOptions;
+    int memoryBudgetMB = 1024;
+    int shardCount = 0; // 0 serves everything from this process
+    ShardPartition partition = PARTITION_BY_INDUSTRY;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.find("--similarity=") == 0) {
+            buildOptions.similarityPolicy = arg.substr(13);
+        }
+        else if (arg.find("--knn=") == 0) {
+            buildOptions.knnNeighbors = atoi(arg.substr(6).c_str());
+        }
+        else if (arg.find("--memory-budget-mb=") == 0) {
+            memoryBudgetMB = atoi(arg.substr(19).c_str());
+        }
+        else if (arg == "--external-build") {
+            buildOptions.externalBuild = true;
+        }
+        else if (arg == "--lsh-build") {
+            buildOptions.lshBuild = true;
+        }
+        else if (arg.find("--temp-dir=") == 0) {
+            buildOptions.externalOptions.tempDirectory = arg.substr(11);
+        }
+        else if (arg.find("--block-size=") == 0) {
+            buildOptions.externalOptions.blockSize = atoi(arg.substr(13).c_str());
+        }
+        else if (arg.find("--shards=") == 0) {
+            shardCount = atoi(arg.substr(9).c_str());
+        }
+        else if (arg == "--partition=industry") {
+            partition = PARTITION_BY_INDUSTRY;
+        }
+        else if (arg == "--partition=hash") {
+            partition = PARTITION_BY_HASH;
+        }
+        else if (arg == "--reorder=none" || arg == "--reorder=attributes" || arg == "--reorder=rcm") {
+            buildOptions.reorder = arg.substr(10);
+        }
+        else {
+            cout << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+    }
+    buildOptions.memoryBudget = (size_t)memoryBudgetMB * 1024 * 1024;
+    const string& similarityPolicy = buildOptions.similarityPolicy;
+    
+    SimilarityPolicyRegistry policyRegistry = SimilarityPolicyRegistry::createDefault();
+    if (!policyRegistry.hasPolicy(similarityPolicy)) {
+        cout << "Unknown similarity policy: " << similarityPolicy << "\n";
+        cout << "Available policies:";
+        vector<string> policyNames = policyRegistry.getPolicyNames();
+        for (int i = 0; i < policyNames.size(); i++) {
+            cout << " " << policyNames[i];
+        }
+        cout << "\n";
+        return 1;
+    }
+    
     cout << "==========================================\n";
     cout << "   MOVIE RECOMMENDATION SYSTEM\n";
     cout << "==========================================\n";
@@ -603,24 +2742,41 @@ int main() {
     sampleMovies.push_back(Movie(movieId++, "Ae Dil Hai Mushkil", "Rom-Com", "Ranbir Kapoor", 7.4, "Bollywood"));
     sampleMovies.push_back(Movie(movieId++, "Tamasha", "Rom-Com", "Ranbir Kapoor", 7.8, "Bollywood"));
     
-    // Initialize Content-Based Recommender
+    // Initialize the Content-Based and Graph-Based Recommenders, or the worker processes that own their shards
     ContentBasedRecommender contentRecommender;
-    for (int i = 0; i < sampleMovies.size(); i++) {
-        contentRecommender.addMovie(sampleMovies[i]);
-    }
-    
-    // Initialize Graph-Based Recommender
     GraphBasedRecommender graphRecommender;
-    for (int i = 0; i < sampleMovies.size(); i++) {
-        graphRecommender.addMovie(sampleMovies[i]);
-    }
+    ShardCoordinator shardCoordinator;
+    bool sharded = shardCount > 0;
     
-    // Build similarity graph
-    graphRecommender.buildSimilarityGraph();
+    if (sharded) {
+        if (!shardCoordinator.start(sampleMovies, shardCount, partition, buildOptions)) {
+            cout << "Could not start the shard worker processes or build their similarity graphs!\n";
+            return 1;
+        }
+    }
+    else {
+        for (int i = 0; i < sampleMovies.size(); i++) {
+            contentRecommender.addMovie(sampleMovies[i]);
+            graphRecommender.addMovie(sampleMovies[i]);
+        }
+        
+        // Build similarity graph with the selected policy
+        if (!buildGraphRecommender(policyRegistry, graphRecommender, buildOptions, true)) {
+            return 1;
+        }
+    }
     
     cout << "\nWELCOME TO MOVIE RECOMMENDATION SYSTEM\n";
     cout << "=============================================\n";
     cout << "Total Movies in Database: " << sampleMovies.size() << "\n";
+    cout << "Similarity Policy: " << similarityPolicy << "\n";
+    if (sharded) {
+        cout << "Sharded Mode: " << shardCoordinator.getShardCount() << " worker processes, partitioned by "
+             << (partition == PARTITION_BY_INDUSTRY ? "industry" : "hash") << "\n";
+        if (shardCoordinator.getShardCount() < shardCount) {
+            cout << "   (--shards=" << shardCount << " capped at one shard per industry)\n";
+        }
+    }
     cout << "=============================================\n";
     
     while (true) {
@@ -656,7 +2812,8 @@ int main() {
         cout << "=============================================\n";
         
         // Get genres available in this industry
-        vector<string> industryGenres = contentRecommender.getGenresByIndustry(selectedIndustry);
+        vector<string> industryGenres = sharded ? shardCoordinator.getGenresByIndustry(selectedIndustry)
+                                                : contentRecommender.getGenresByIndustry(selectedIndustry);
         
         if (industryGenres.empty()) {
             cout << "No genres found for " << selectedIndustry << "\n";
@@ -694,13 +2851,14 @@ int main() {
         cout << "\nSELECTED GENRE: " << selectedGenre << " (" << selectedIndustry << ")\n";
         cout << "=============================================\n";
         
-        // Get movies in this genre and industry
-        vector<pair<Movie, int> > genreMoviesWithIndices = 
-            contentRecommender.getMoviesInGenreWithIndices(selectedGenre, selectedIndustry);
-        vector<Movie> genreMovies = 
-            contentRecommender.getMoviesByGenreAndIndustry(selectedGenre, selectedIndustry);
+        // Count movies in this genre and industry by lead actor
+        map<string, int> actorCount;
+        map<string, double> actorRatingSum;
+        int genreMovieCount = sharded ? shardCoordinator.countGenreActors(selectedGenre, selectedIndustry, actorCount, actorRatingSum)
+                                      : countActors(contentRecommender.getMoviesByGenreAndIndustry(selectedGenre, selectedIndustry), 
+                                                    actorCount, actorRatingSum);
         
-        cout << "\nTotal " << selectedGenre << " movies in " << selectedIndustry << ": " << genreMovies.size() << "\n";
+        cout << "\nTotal " << selectedGenre << " movies in " << selectedIndustry << ": " << genreMovieCount << "\n";
         
         // Ask for recommendation type
         cout << "\nWhat would you like to see?\n";
@@ -727,19 +2885,21 @@ int main() {
         switch(recChoice) {
             case 1: {
                 // Top Rated in Genre only
-                displayedRecommendations = contentRecommender.recommendByGenreAndIndustry(selectedGenre, selectedIndustry, 5);
+                displayedRecommendations = sharded ? shardCoordinator.recommendByGenreAndIndustry(selectedGenre, selectedIndustry, 5)
+                                                   : contentRecommender.recommendByGenreAndIndustry(selectedGenre, selectedIndustry, 5);
                 displayRecommendations(displayedRecommendations, "Top Rated in Genre", 5);
                 break;
             }
             case 2: {
                 // Graph-Based Similarity only
-                displayedRecommendations = graphRecommender.recommendByGenreGraph(selectedGenre, selectedIndustry, 5);
+                displayedRecommendations = sharded ? shardCoordinator.recommendByGenreGraph(selectedGenre, selectedIndustry, 5)
+                                                   : graphRecommender.recommendByGenreGraph(selectedGenre, selectedIndustry, 5);
                 displayRecommendations(displayedRecommendations, "Graph-Based (Similarity) Recommendations", 5);
                 break;
             }
             case 3: {
                 // Popular Actors only
-                displayPopularActors(selectedGenre, genreMovies, 3);
+                displayPopularActors(selectedGenre, actorCount, actorRatingSum, 3);
                 cout << "\nPress Enter to continue...";
                 cin.ignore(10000, '\n');
                 cin.get();
@@ -750,20 +2910,23 @@ int main() {
                 cout << "\nALL RECOMMENDATIONS FOR " << selectedGenre << " (" << selectedIndustry << "):\n";
                 cout << "----------------------------------------\n";
                 
-                vector<Movie> topRatedRecs = contentRecommender.recommendByGenreAndIndustry(selectedGenre, selectedIndustry, 5);
+                vector<Movie> topRatedRecs = sharded ? shardCoordinator.recommendByGenreAndIndustry(selectedGenre, selectedIndustry, 5)
+                                                     : contentRecommender.recommendByGenreAndIndustry(selectedGenre, selectedIndustry, 5);
                 displayRecommendations(topRatedRecs, "Top Rated in Genre", 5);
                 
-                vector<Movie> graphRecs = graphRecommender.recommendByGenreGraph(selectedGenre, selectedIndustry, 5);
+                vector<Movie> graphRecs = sharded ? shardCoordinator.recommendByGenreGraph(selectedGenre, selectedIndustry, 5)
+                                                  : graphRecommender.recommendByGenreGraph(selectedGenre, selectedIndustry, 5);
                 displayRecommendations(graphRecs, "Graph-Based (Similarity)", 5);
                 
-                displayPopularActors(selectedGenre, genreMovies, 3);
+                displayPopularActors(selectedGenre, actorCount, actorRatingSum, 3);
                 
                 displayedRecommendations = topRatedRecs;
                 break;
             }
             default: {
                 cout << "Invalid choice! Showing default (Top Rated).\n";
-                displayedRecommendations = contentRecommender.recommendByGenreAndIndustry(selectedGenre, selectedIndustry, 5);
+                displayedRecommendations = sharded ? shardCoordinator.recommendByGenreAndIndustry(selectedGenre, selectedIndustry, 5)
+                                                   : contentRecommender.recommendByGenreAndIndustry(selectedGenre, selectedIndustry, 5);
                 displayRecommendations(displayedRecommendations, "Top Rated in Genre", 5);
             }
         }
@@ -798,7 +2961,8 @@ int main() {
                 // Find similar movies
                 cout << "\nIf you like " << selectedMovie.title << ", you might also like (Top 3):\n";
                 
-                vector<Movie> similarMovies = graphRecommender.findSimilarMovies(selectedMovie.title, 3);
+                vector<Movie> similarMovies = sharded ? shardCoordinator.findSimilarMovies(selectedMovie.title, 3)
+                                                      : graphRecommender.findSimilarMovies(selectedMovie.title, 3);
                 if (!similarMovies.empty()) {
                     for (int i = 0; i < similarMovies.size(); i++) {
                         cout << "   * " << similarMovies[i].title 
@@ -807,7 +2971,8 @@ int main() {
                 }
                 
                 // Get actor-based recommendations
-                vector<Movie> actorRecs = contentRecommender.recommendByActor(selectedMovie.actor, 2);
+                vector<Movie> actorRecs = sharded ? shardCoordinator.recommendByActor(selectedMovie.actor, 2)
+                                                  : contentRecommender.recommendByActor(selectedMovie.actor, 2);
                 bool hasActorRecs = false;
                 for (int i = 0; i < actorRecs.size(); i++) {
                     if (actorRecs[i].title != selectedMovie.title) {
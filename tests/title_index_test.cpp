@@ -0,0 +1,46 @@
+// Regression checks for TitleIndex lookups over mixed ASCII and UTF-8 titles.
+// Build from the repository root:
+//   g++ -o title_index_test tests/title_index_test.cpp && ./title_index_test
+#define main movieRecommendationMain
+#include "../movie_recommendation_system.cpp"
+#undef main
+
+int failures = 0;
+
+void check(bool condition, const string& description) {
+    if (!condition) {
+        cout << "FAILED: " << description << "\n";
+        failures++;
+    }
+}
+
+int main() {
+    TitleIndex index;
+    index.addTitle("Amelie", 1);
+    index.addTitle("Zorro", 2);
+    index.addTitle("\xc3\x89lite", 3);   // Élite
+    index.addTitle("Bambi", 4);
+    index.addTitle("\xc3\xa0 bout", 5);  // à bout
+    index.addTitle("Yojimbo", 6);
+    
+    check(index.findExact("Amelie") == 1, "findExact(Amelie)");
+    check(index.findExact("Zorro") == 2, "findExact(Zorro)");
+    check(index.findExact("\xc3\x89lite") == 3, "findExact(Elite with acute accent)");
+    check(index.findExact("Bambi") == 4, "findExact(Bambi)");
+    check(index.findExact("\xc3\xa0 bout") == 5, "findExact(a bout with grave accent)");
+    check(index.findExact("Yojimbo") == 6, "findExact(Yojimbo)");
+    check(index.findExact("Zorr") == -1, "findExact(Zorr) misses");
+    
+    check(index.completePrefix("\xc3").size() == 2, "completePrefix(0xc3) finds both UTF-8 titles");
+    check(index.completePrefix("zo").size() == 1, "completePrefix(zo)");
+    check(index.completePrefix("", -1).empty(), "completePrefix with a negative limit finds nothing");
+    check(index.fuzzyMatch("Zorro", 2, -1).empty(), "fuzzyMatch with a negative limit finds nothing");
+    
+    int editDistance;
+    check(index.findClosest("Yojimbi", editDistance) == 6 && editDistance == 1, "findClosest(Yojimbi)");
+    
+    if (failures == 0) {
+        cout << "All title index checks passed.\n";
+    }
+    return failures == 0 ? 0 : 1;
+}